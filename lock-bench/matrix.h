@@ -0,0 +1,255 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Latency histogram with 16 linear sub-buckets per power of two,
+// so percentiles are within ~6% of the exact value and recording is O(1)
+class LatencyHistogram {
+public:
+    static constexpr size_t kSubBits = 4;
+    static constexpr size_t kNumSub = size_t{1} << kSubBits;
+    static constexpr size_t kNumBuckets = 64 * kNumSub;
+
+    void Record(uint64_t value) {
+        ++counts_[BucketOf(value)];
+        ++total_;
+    }
+
+    void Merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < kNumBuckets; ++i) {
+            counts_[i] += other.counts_[i];
+        }
+        total_ += other.total_;
+    }
+
+    uint64_t Count() const {
+        return total_;
+    }
+
+    // Upper bound of the bucket holding the q-th quantile, q in [0, 1]
+    uint64_t Percentile(double q) const {
+        if (!total_) {
+            return 0;
+        }
+        auto rank = static_cast<uint64_t>(std::ceil(q * static_cast<double>(total_)));
+        rank = std::clamp<uint64_t>(rank, 1, total_);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kNumBuckets; ++i) {
+            seen += counts_[i];
+            if (seen >= rank) {
+                return UpperBound(i);
+            }
+        }
+        return UpperBound(kNumBuckets - 1);
+    }
+
+    static size_t BucketOf(uint64_t value) {
+        if (value < kNumSub) {
+            return value;
+        }
+        auto shift = std::bit_width(value) - 1 - kSubBits;
+        auto sub = (value >> shift) & (kNumSub - 1);
+        return (shift + 1) * kNumSub + sub;
+    }
+
+    static uint64_t UpperBound(size_t bucket) {
+        if (bucket < kNumSub) {
+            return bucket;
+        }
+        auto shift = bucket / kNumSub - 1;
+        auto sub = bucket % kNumSub;
+        return ((kNumSub + sub + 1) << shift) - 1;
+    }
+
+private:
+    std::array<uint64_t, kNumBuckets> counts_{};
+    uint64_t total_ = 0;
+};
+
+// Busy work measured in TSC ticks, which are close to CPU cycles
+inline void BurnCycles(uint64_t cycles) {
+    if (!cycles) {
+        return;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    auto start = __rdtsc();
+    while (__rdtsc() - start < cycles) {
+    }
+#else
+    for (uint64_t i = 0; i < cycles; ++i) {
+        asm volatile("" ::: "memory");
+    }
+#endif
+}
+
+// Min/max ratio and coefficient of variation of per-thread acquisition counts:
+// 1 and 0 for a perfectly fair lock
+struct Fairness {
+    double min_max_ratio = 1;
+    double cv = 0;
+};
+
+inline Fairness ComputeFairness(const std::vector<uint64_t>& counts) {
+    if (counts.empty()) {
+        return {};
+    }
+    auto [min, max] = std::ranges::minmax(counts);
+    double mean = 0;
+    for (auto count : counts) {
+        mean += static_cast<double>(count);
+    }
+    mean /= static_cast<double>(counts.size());
+    double variance = 0;
+    for (auto count : counts) {
+        variance += (static_cast<double>(count) - mean) * (static_cast<double>(count) - mean);
+    }
+    variance /= static_cast<double>(counts.size());
+    Fairness fairness;
+    fairness.min_max_ratio = max ? static_cast<double>(min) / static_cast<double>(max) : 1;
+    fairness.cv = mean > 0 ? std::sqrt(variance) / mean : 0;
+    return fairness;
+}
+
+struct MatrixCell {
+    uint32_t num_threads = 1;
+    uint64_t critical_section_cycles = 0;
+    uint64_t think_cycles = 0;
+};
+
+struct MatrixResult {
+    std::string lock;
+    MatrixCell cell;
+    uint64_t num_ops = 0;
+    double ops_per_second = 0;
+    uint64_t p50_ns = 0;
+    uint64_t p99_ns = 0;
+    uint64_t p999_ns = 0;
+    Fairness fairness;
+};
+
+// Uniform interface over Lock()/Unlock(), lock()/unlock() and Write(func) locks
+template <class Lock>
+void WithLock(Lock& lock, auto func) {
+    if constexpr (requires { lock.Lock(); }) {
+        lock.Lock();
+        func();
+        lock.Unlock();
+    } else if constexpr (requires { lock.lock(); }) {
+        lock.lock();
+        func();
+        lock.unlock();
+    } else {
+        lock.Write(func);
+    }
+}
+
+// Every thread repeats: think, acquire (timed), work inside the critical section, release
+template <class Lock>
+MatrixResult RunCell(const std::string& name, Lock& lock, MatrixCell cell,
+                     std::chrono::nanoseconds duration) {
+    struct alignas(64) PerThread {
+        LatencyHistogram latency;
+        uint64_t num_ops = 0;
+    };
+    std::vector<PerThread> per_thread(cell.num_threads);
+    std::atomic<uint32_t> num_ready{0};
+    std::atomic<bool> stop{false};
+    uint64_t shared_counter = 0;
+
+    std::chrono::steady_clock::time_point start;
+    {
+        std::vector<std::jthread> threads;
+        for (uint32_t i = 0; i < cell.num_threads; ++i) {
+            threads.emplace_back([&, i] {
+                auto& mine = per_thread[i];
+                num_ready.fetch_add(1);
+                while (num_ready.load() < cell.num_threads + 1) {
+                    std::this_thread::yield();
+                }
+                while (!stop.load(std::memory_order_relaxed)) {
+                    BurnCycles(cell.think_cycles);
+                    auto begin = std::chrono::steady_clock::now();
+                    std::chrono::steady_clock::time_point acquired;
+                    WithLock(lock, [&] {
+                        acquired = std::chrono::steady_clock::now();
+                        BurnCycles(cell.critical_section_cycles);
+                        ++shared_counter;
+                    });
+                    auto latency = acquired - begin;
+                    mine.latency.Record(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count());
+                    ++mine.num_ops;
+                }
+            });
+        }
+        while (num_ready.load() < cell.num_threads) {
+            std::this_thread::yield();
+        }
+        start = std::chrono::steady_clock::now();
+        num_ready.fetch_add(1);
+        std::this_thread::sleep_for(duration);
+        stop.store(true);
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+
+    MatrixResult result{.lock = name, .cell = cell};
+    LatencyHistogram latency;
+    std::vector<uint64_t> counts;
+    for (const auto& mine : per_thread) {
+        latency.Merge(mine.latency);
+        counts.push_back(mine.num_ops);
+        result.num_ops += mine.num_ops;
+    }
+    if (shared_counter != result.num_ops) {
+        throw std::logic_error{name + " is not a lock: lost updates"};
+    }
+    result.ops_per_second = static_cast<double>(result.num_ops) / elapsed.count();
+    result.p50_ns = latency.Percentile(0.5);
+    result.p99_ns = latency.Percentile(0.99);
+    result.p999_ns = latency.Percentile(0.999);
+    result.fairness = ComputeFairness(counts);
+    return result;
+}
+
+inline void WriteCsv(std::ostream& out, const std::vector<MatrixResult>& results) {
+    out << "lock,threads,cs_cycles,think_cycles,ops,ops_per_sec,p50_ns,p99_ns,p999_ns,"
+           "fairness_min_max,fairness_cv\n";
+    for (const auto& r : results) {
+        out << r.lock << ',' << r.cell.num_threads << ',' << r.cell.critical_section_cycles << ','
+            << r.cell.think_cycles << ',' << r.num_ops << ',' << r.ops_per_second << ','
+            << r.p50_ns << ',' << r.p99_ns << ',' << r.p999_ns << ','
+            << r.fairness.min_max_ratio << ',' << r.fairness.cv << '\n';
+    }
+}
+
+inline void WriteJson(std::ostream& out, const std::vector<MatrixResult>& results) {
+    out << "[\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        out << "  {\"lock\": \"" << r.lock << "\", \"threads\": " << r.cell.num_threads
+            << ", \"cs_cycles\": " << r.cell.critical_section_cycles
+            << ", \"think_cycles\": " << r.cell.think_cycles << ", \"ops\": " << r.num_ops
+            << ", \"ops_per_sec\": " << r.ops_per_second << ", \"p50_ns\": " << r.p50_ns
+            << ", \"p99_ns\": " << r.p99_ns << ", \"p999_ns\": " << r.p999_ns
+            << ", \"fairness_min_max\": " << r.fairness.min_max_ratio
+            << ", \"fairness_cv\": " << r.fairness.cv << "}"
+            << (i + 1 < results.size() ? "," : "") << '\n';
+    }
+    out << "]\n";
+}
@@ -0,0 +1,99 @@
+#include "matrix.h"
+#include "../spinlock/spinlock.h"
+#include "../spinlock/queue_lock.h"
+#include "../spinlock/cohort_lock.h"
+#include "../mutex/mutex.h"
+#include "../rw-lock/rw_lock.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+// Environment:
+//   LOCK_BENCH_DURATION_MS - time spent in every cell of the grid (default 100)
+//   LOCK_BENCH_OUTPUT      - prefix of the .csv and .json result files (default lock_bench)
+//   LOCK_BENCH_LOCKS       - comma separated subset of lock names to run (default all)
+
+namespace {
+
+using namespace std::chrono_literals;
+
+std::string GetEnv(const char* name, std::string default_value) {
+    const auto* value = std::getenv(name);
+    return value ? value : default_value;
+}
+
+class Matrix {
+public:
+    Matrix()
+        : duration_{std::stoul(GetEnv("LOCK_BENCH_DURATION_MS", "100")) * 1ms},
+          locks_{"," + GetEnv("LOCK_BENCH_LOCKS", "") + ","} {
+        auto max_threads = 2 * std::max(1u, std::thread::hardware_concurrency());
+        for (uint32_t num_threads = 1; num_threads < max_threads; num_threads *= 2) {
+            thread_counts_.push_back(num_threads);
+        }
+        thread_counts_.push_back(max_threads);
+    }
+
+    template <class Lock>
+    void Run(const std::string& name) {
+        if (locks_ != ",," && locks_.find("," + name + ",") == std::string::npos) {
+            return;
+        }
+        for (auto num_threads : thread_counts_) {
+            for (uint64_t critical_section : {0, 100, 1'000}) {
+                for (uint64_t think : {0, 1'000}) {
+                    Lock lock;
+                    auto result = RunCell(name, lock, {num_threads, critical_section, think},
+                                          duration_);
+                    std::cout << name << " threads=" << num_threads
+                              << " cs=" << critical_section << " think=" << think
+                              << ": " << result.ops_per_second << " ops/s, p50 "
+                              << result.p50_ns << "ns, p99 " << result.p99_ns << "ns, p99.9 "
+                              << result.p999_ns << "ns, fairness "
+                              << result.fairness.min_max_ratio << std::endl;
+                    results_.push_back(std::move(result));
+                }
+            }
+        }
+    }
+
+    void Save() const {
+        auto prefix = GetEnv("LOCK_BENCH_OUTPUT", "lock_bench");
+        std::ofstream csv{prefix + ".csv"};
+        WriteCsv(csv, results_);
+        std::ofstream json{prefix + ".json"};
+        WriteJson(json, results_);
+    }
+
+private:
+    std::chrono::nanoseconds duration_;
+    std::string locks_;
+    std::vector<uint32_t> thread_counts_;
+    std::vector<MatrixResult> results_;
+};
+
+}  // namespace
+
+TEST_CASE("Matrix") {
+    Matrix matrix;
+    matrix.Run<BasicSpinLock<YieldWait>>("SpinLock<YieldWait>");
+    matrix.Run<BasicSpinLock<PauseWait>>("SpinLock<PauseWait>");
+    matrix.Run<BasicSpinLock<BackoffWait>>("SpinLock<BackoffWait>");
+    matrix.Run<BasicSpinLock<ParkWait>>("SpinLock<ParkWait>");
+    matrix.Run<TicketLock>("TicketLock");
+    matrix.Run<MCSLock>("MCSLock");
+    matrix.Run<CLHLock>("CLHLock");
+    matrix.Run<CohortLock>("CohortLock");
+    matrix.Run<Mutex>("Mutex");
+    matrix.Run<RWLock>("RWLock");
+    matrix.Run<std::mutex>("std::mutex");
+    matrix.Save();
+}
@@ -0,0 +1,56 @@
+#include "matrix.h"
+
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Histogram") {
+    LatencyHistogram histogram;
+    for (uint64_t value = 1; value <= 1'000; ++value) {
+        histogram.Record(value);
+    }
+    REQUIRE(histogram.Count() == 1'000);
+    auto p50 = histogram.Percentile(0.5);
+    REQUIRE(p50 >= 500);
+    REQUIRE(p50 <= 500 * 17 / 16);
+    auto p99 = histogram.Percentile(0.99);
+    REQUIRE(p99 >= 990);
+    REQUIRE(p99 <= 990 * 17 / 16);
+    REQUIRE(histogram.Percentile(1) >= 1'000);
+
+    for (uint64_t value : {0ull, 1ull, 15ull, 16ull, 17ull, 1'000'000ull, ~0ull}) {
+        auto bucket = LatencyHistogram::BucketOf(value);
+        REQUIRE(bucket < LatencyHistogram::kNumBuckets);
+        REQUIRE(LatencyHistogram::UpperBound(bucket) >= value);
+    }
+}
+
+TEST_CASE("Fairness") {
+    auto fair = ComputeFairness({10, 10, 10});
+    REQUIRE(fair.min_max_ratio == 1);
+    REQUIRE(fair.cv == 0);
+    auto unfair = ComputeFairness({0, 10});
+    REQUIRE(unfair.min_max_ratio == 0);
+    REQUIRE(unfair.cv == 1);
+}
+
+TEST_CASE("Cell") {
+    std::mutex mutex;
+    auto result = RunCell("std::mutex", mutex, {4, 100, 100}, 100ms);
+    REQUIRE(result.num_ops > 0);
+    REQUIRE(result.p50_ns <= result.p99_ns);
+    REQUIRE(result.p99_ns <= result.p999_ns);
+
+    std::stringstream csv;
+    WriteCsv(csv, {result});
+    REQUIRE(csv.str().starts_with("lock,threads,"));
+    REQUIRE(csv.str().find("\nstd::mutex,4,100,100,") != std::string::npos);
+
+    std::stringstream json;
+    WriteJson(json, {result});
+    REQUIRE(json.str().find("\"lock\": \"std::mutex\", \"threads\": 4") != std::string::npos);
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "mutex.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <mutex>
+
+// Condition variable for Mutex, waiting on a sequence number futex.
+// NotifyAll wakes a single waiter and requeues the rest onto the futex of the mutex,
+// so they are woken one by one by Unlock instead of all racing for the mutex at once.
+class CondVar {
+public:
+    // May return spuriously
+    void Wait(Mutex& mutex) {
+        auto seq = Prepare(mutex);
+        mutex.Unlock();
+        FutexWait(&seq_, seq);
+        Finish(mutex);
+    }
+
+    template <class Predicate>
+    void Wait(Mutex& mutex, Predicate stop_waiting) {
+        while (!stop_waiting()) {
+            Wait(mutex);
+        }
+    }
+
+    template <class Clock, class Duration>
+    std::cv_status WaitUntil(Mutex& mutex,
+                             const std::chrono::time_point<Clock, Duration>& deadline) {
+        auto seq = Prepare(mutex);
+        mutex.Unlock();
+        auto timeout = deadline - Clock::now();
+        if (timeout > timeout.zero()) {
+            FutexWaitFor(&seq_, seq, std::chrono::ceil<std::chrono::nanoseconds>(timeout));
+        }
+        Finish(mutex);
+        return Clock::now() < deadline ? std::cv_status::no_timeout : std::cv_status::timeout;
+    }
+
+    // Returns stop_waiting() as of the last check
+    template <class Clock, class Duration, class Predicate>
+    bool WaitUntil(Mutex& mutex, const std::chrono::time_point<Clock, Duration>& deadline,
+                   Predicate stop_waiting) {
+        while (!stop_waiting()) {
+            if (WaitUntil(mutex, deadline) == std::cv_status::timeout) {
+                return stop_waiting();
+            }
+        }
+        return true;
+    }
+
+    template <class Rep, class Period>
+    std::cv_status WaitFor(Mutex& mutex, const std::chrono::duration<Rep, Period>& timeout) {
+        return WaitUntil(mutex, std::chrono::steady_clock::now() + timeout);
+    }
+
+    template <class Rep, class Period, class Predicate>
+    bool WaitFor(Mutex& mutex, const std::chrono::duration<Rep, Period>& timeout,
+                 Predicate stop_waiting) {
+        return WaitUntil(mutex, std::chrono::steady_clock::now() + timeout, stop_waiting);
+    }
+
+    void NotifyOne() {
+        std::atomic_ref<int>(seq_).fetch_add(1);
+        if (num_waiters_.load() > 0) {
+            FutexWake(&seq_, 1);
+        }
+    }
+
+    void NotifyAll() {
+        auto seq_atm = std::atomic_ref<int>(seq_);
+        auto seq = seq_atm.fetch_add(1) + 1;
+        if (num_waiters_.load() == 0) {
+            return;
+        }
+        auto* mutex = mutex_.load(std::memory_order::relaxed);
+        // EAGAIN means seq_ changed in between, then waiters that came later are moved too.
+        // Any other error would come back on every retry
+        while (FutexRequeue(&seq_, seq, /*wake_count=*/1, /*requeue_count=*/INT_MAX,
+                            &mutex->locked_) == EAGAIN) {
+            seq = seq_atm.load();
+        }
+    }
+
+    // With the std::condition_variable interface, to be used with std::unique_lock<Mutex>
+
+    void wait(std::unique_lock<Mutex>& lock) {
+        Wait(*lock.mutex());
+    }
+
+    template <class Predicate>
+    void wait(std::unique_lock<Mutex>& lock, Predicate stop_waiting) {
+        Wait(*lock.mutex(), std::move(stop_waiting));
+    }
+
+    void notify_one() {
+        NotifyOne();
+    }
+
+    void notify_all() {
+        NotifyAll();
+    }
+
+private:
+    // num_waiters_ and seq_ are accessed with seq_cst: a notifier either sees the waiter
+    // or bumps seq_ before the waiter reads it, so skipping the syscall loses no wakeups
+    int Prepare(Mutex& mutex) {
+        mutex_.store(&mutex, std::memory_order::relaxed);
+        num_waiters_.fetch_add(1);
+        return std::atomic_ref<int>(seq_).load();
+    }
+
+    // The thread may have been requeued onto the mutex among other sleepers
+    void Finish(Mutex& mutex) {
+        mutex.Parking();
+        num_waiters_.fetch_sub(1, std::memory_order::relaxed);
+    }
+
+    int seq_{0};
+    std::atomic<int> num_waiters_{0};
+    // All waiters must use the same mutex
+    std::atomic<Mutex*> mutex_{nullptr};
+};
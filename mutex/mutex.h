@@ -1,10 +1,19 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <thread>
+
+#include <cerrno>
 
 #include <linux/futex.h>
+#include <pthread.h>
 #include <sys/syscall.h>
 #include <sys/time.h>
+#include <unistd.h>
 
 // Atomically do the following:
 //    if (*value == expected_value) {
@@ -14,25 +23,142 @@ inline void FutexWait(int* value, int expected_value) {
     syscall(SYS_futex, value, FUTEX_WAIT_PRIVATE, expected_value, nullptr, nullptr, 0);
 }
 
+// FutexWait that gives up after timeout
+inline void FutexWaitFor(int* value, int expected_value, std::chrono::nanoseconds timeout) {
+    using namespace std::chrono_literals;
+    timespec ts{.tv_sec = timeout / 1s, .tv_nsec = (timeout % 1s).count()};
+    syscall(SYS_futex, value, FUTEX_WAIT_PRIVATE, expected_value, &ts, nullptr, 0);
+}
+
 // Wakeup 'count' threads sleeping on address of value (-1 wakes all)
 inline void FutexWake(int* value, int count) {
+    // The kernel wakes a single thread for any count below 1
+    count = count < 0 ? INT_MAX : count;
     syscall(SYS_futex, value, FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
 }
 
+// FutexWait and FutexWake that tag sleepers with a bitset: a wakeup reaches only the
+// sleepers whose bitset intersects its own
+inline void FutexWaitBitset(int* value, int expected_value, uint32_t bitset) {
+    syscall(SYS_futex, value, FUTEX_WAIT_BITSET_PRIVATE, expected_value, nullptr, nullptr,
+            bitset);
+}
+
+inline void FutexWakeBitset(int* value, int count, uint32_t bitset) {
+    count = count < 0 ? INT_MAX : count;
+    syscall(SYS_futex, value, FUTEX_WAKE_BITSET_PRIVATE, count, nullptr, nullptr, bitset);
+}
+
+// FutexWait and FutexWake for words in memory shared between processes
+inline void FutexWaitShared(int* value, int expected_value) {
+    syscall(SYS_futex, value, FUTEX_WAIT, expected_value, nullptr, nullptr, 0);
+}
+
+inline void FutexWakeShared(int* value, int count) {
+    count = count < 0 ? INT_MAX : count;
+    syscall(SYS_futex, value, FUTEX_WAKE, count, nullptr, nullptr, 0);
+}
+
+// Priority-inheritance futex ops on a word holding the owner thread id:
+// FutexLockPi sleeps until the kernel hands the lock over, boosting the owner meanwhile,
+// and returns 0 or an errno value
+inline int FutexLockPi(int* value) {
+    while (syscall(SYS_futex, value, FUTEX_LOCK_PI_PRIVATE, 0, nullptr, nullptr, 0) != 0) {
+        // EAGAIN: the owner is exiting
+        if (errno != EAGAIN && errno != EINTR) {
+            return errno;
+        }
+    }
+    return 0;
+}
+
+inline void FutexUnlockPi(int* value) {
+    syscall(SYS_futex, value, FUTEX_UNLOCK_PI_PRIVATE, 0, nullptr, nullptr, 0);
+}
+
+// Kernel id of the calling thread; the cached value is reset in the child after fork
+inline int ThisThreadId() {
+    static thread_local int tid = 0;
+    static const bool at_fork_registered = [] {
+        pthread_atfork(nullptr, nullptr, [] { tid = 0; });
+        return true;
+    }();
+    static_cast<void>(at_fork_registered);
+    if (!tid) {
+        tid = static_cast<int>(syscall(SYS_gettid));
+    }
+    return tid;
+}
+
+// Atomically do the following:
+//    if (*value != expected_value) {
+//        return EAGAIN
+//    }
+//    wake up 'wake_count' threads sleeping on address of value,
+//    move up to 'requeue_count' others to sleep on address of target
+// Returns 0 or an errno value
+inline int FutexRequeue(int* value, int expected_value, int wake_count, int requeue_count,
+                        int* target) {
+    auto* requeue = reinterpret_cast<const timespec*>(static_cast<uintptr_t>(requeue_count));
+    if (syscall(SYS_futex, value, FUTEX_CMP_REQUEUE_PRIVATE, wake_count, requeue, target,
+                expected_value) < 0) {
+        return errno;
+    }
+    return 0;
+}
+
+// Hint to the CPU that we are in a spin-wait loop
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+// Starvation mode: a waiter that has been parked for longer than starvation_threshold
+// joins a FIFO queue, and while the queue is not empty Unlock hands the lock straight
+// to its head without ever releasing it, and newcomers skip the fast path to queue up too.
+// Once the queue drains the mutex is back to the usual barging mode.
 class Mutex {
 public:
+    static constexpr int kDefaultMaxSpins = 1'000;
+    static constexpr std::chrono::nanoseconds kDefaultStarvationThreshold =
+        std::chrono::milliseconds{1};
+    static constexpr std::chrono::nanoseconds kNoStarvationMode =
+        std::chrono::nanoseconds::max();
+
+    // max_spins bounds the adaptive spinning before parking, 0 turns it off
+    explicit Mutex(int max_spins = kDefaultMaxSpins,
+                   std::chrono::nanoseconds starvation_threshold = kDefaultStarvationThreshold)
+        : max_spins_{max_spins}, starvation_threshold_{starvation_threshold} {
+    }
+
     void Lock() {
-        if (!TryLock()) {
+        if (num_starving_.load() > 0 || (!TryLock() && !Spin())) {
             Parking();
         }
     }
 
     void Unlock() {
         auto locked_atm = std::atomic_ref<int>(locked_);
-        if (locked_atm.fetch_sub(1, std::memory_order::release) != 1) {
-            locked_atm.store(0, std::memory_order::release);
-            FutexWake(&locked_, 1);
+        if (locked_atm.fetch_sub(1) == 1) {
+            return;
         }
+        // A starving waiter bumps num_starving_ before it raises locked_ to 2, so the lock is
+        // only let go once num_starving_ was seen at 0 after the last change of locked_.
+        // A 2 that is dropped then came from a parked thread, which takes the lock back
+        // with 2 and so hands it over on its own Unlock.
+        auto state = 1;
+        while (true) {
+            if (num_starving_.load() > 0 && HandOff()) {
+                return;
+            }
+            if (locked_atm.compare_exchange_strong(state, 0)) {
+                break;
+            }
+        }
+        FutexWake(&locked_, 1);
     }
 
     // BasicLockable
@@ -47,32 +173,147 @@ public:
     }
 
 private:
+    friend class CondVar;
+
+    struct Waiter {
+        int granted{0};
+        Waiter* next = nullptr;
+    };
+
+    // 0 - unlocked, 1 - locked, 2 - locked and somebody may sleep on the futex
     int locked_{0};
+    // Average number of polls after which recent spinners got the lock
+    int spin_budget_{0};
+    const int max_spins_;
+    const std::chrono::nanoseconds starvation_threshold_;
+    std::atomic<int> num_starving_{0};
+    // Protects the queue of starving waiters
+    std::atomic<bool> queue_locked_{false};
+    Waiter* head_ = nullptr;
+    Waiter* tail_ = nullptr;
 
     bool TryLock() {
-        const size_t yield_limit = 0;
-        size_t yield_count = 1;
         int zero = 0;
+        return std::atomic_ref<int>(locked_).compare_exchange_strong(
+            zero, 1, std::memory_order::acquire, std::memory_order::relaxed);
+    }
+
+    // Polls the lock with a PAUSE hint for about twice as long as recent waits took,
+    // which follows the hold time: short critical sections are waited out here, while
+    // long ones drive the budget down so that waiters go to sleep right away.
+    // Stops early if there are sleepers, since the owner hands the lock to one of them,
+    // or starving waiters, which must not be overtaken.
+    bool Spin() {
         auto locked_atm = std::atomic_ref<int>(locked_);
-        while (!locked_atm.compare_exchange_weak(zero, 1, std::memory_order::acquire,
-                                                 std::memory_order::relaxed)) {
-            zero = 0;
-            if (yield_count > yield_limit) {
+        auto budget_atm = std::atomic_ref<int>(spin_budget_);
+        auto budget = budget_atm.load(std::memory_order::relaxed);
+        auto limit = std::min(2 * budget + 10, max_spins_);
+        for (auto num_spins = 0; num_spins < limit; ++num_spins) {
+            auto state = locked_atm.load(std::memory_order::relaxed);
+            if (state == 2 || num_starving_.load(std::memory_order::relaxed) > 0) {
                 return false;
             }
-            ++yield_count;
+            if (state == 0 && TryLock()) {
+                budget_atm.store(budget + (num_spins - budget) / 8, std::memory_order::relaxed);
+                return true;
+            }
+            CpuRelax();
         }
-        return true;
+        budget_atm.store(budget - budget / 8, std::memory_order::relaxed);
+        return false;
     }
 
+    // Takes the lock in the "somebody may sleep" state. Also used by CondVar,
+    // which may have requeued the thread onto locked_ together with others.
     void Parking() {
         auto locked_atm = std::atomic_ref<int>(locked_);
-        do {
+        auto can_starve = starvation_threshold_ != kNoStarvationMode;
+        auto deadline = std::chrono::steady_clock::time_point::max();
+        if (can_starve) {
+            deadline = std::chrono::steady_clock::now() + starvation_threshold_;
+        }
+        while (num_starving_.load() == 0) {
             if (locked_atm.exchange(2, std::memory_order::acquire) == 0) {
                 return;
             }
-            FutexWait(&locked_, /*old=*/2);
-        } while (!TryLock());
-        locked_atm.store(2, std::memory_order::relaxed);
+            if (!can_starve) {
+                FutexWait(&locked_, /*old=*/2);
+                continue;
+            }
+            auto timeout = deadline - std::chrono::steady_clock::now();
+            if (timeout <= timeout.zero()) {
+                break;
+            }
+            FutexWaitFor(&locked_, /*old=*/2, timeout);
+        }
+        LockStarving();
+    }
+
+    void LockStarving() {
+        Waiter waiter;
+        LockQueue();
+        (tail_ ? tail_->next : head_) = &waiter;
+        tail_ = &waiter;
+        num_starving_.fetch_add(1);
+        UnlockQueue();
+
+        // Either the lock is free and we take it, or the owner sees 2 and num_starving_ > 0
+        // when it unlocks, and hands the lock over. Both are seq_cst, see Unlock.
+        if (std::atomic_ref<int>(locked_).exchange(2) == 0) {
+            LockQueue();
+            Waiter* prev = nullptr;
+            for (auto* node = head_; node != &waiter; node = node->next) {
+                prev = node;
+            }
+            (prev ? prev->next : head_) = waiter.next;
+            if (tail_ == &waiter) {
+                tail_ = prev;
+            }
+            num_starving_.fetch_sub(1);
+            UnlockQueue();
+            return;
+        }
+
+        auto granted_atm = std::atomic_ref<int>(waiter.granted);
+        while (granted_atm.load(std::memory_order::acquire) == 0) {
+            FutexWait(&waiter.granted, /*old=*/0);
+        }
+    }
+
+    // Called by the owner on the slow path of Unlock, with the lock still taken.
+    // The lock stays taken and passes to the oldest starving waiter.
+    bool HandOff() {
+        LockQueue();
+        auto* waiter = head_;
+        if (waiter) {
+            head_ = waiter->next;
+            if (!head_) {
+                tail_ = nullptr;
+            }
+            num_starving_.fetch_sub(1);
+        }
+        UnlockQueue();
+        if (!waiter) {
+            return false;
+        }
+        // Keep the next Unlock on the slow path as well
+        std::atomic_ref<int>(locked_).store(2, std::memory_order::relaxed);
+        // The waiter may return and free its node right after the store, in which case
+        // the wakeup hits an unrelated futex and is taken for a spurious one
+        std::atomic_ref<int>(waiter->granted).store(1, std::memory_order::release);
+        FutexWake(&waiter->granted, 1);
+        return true;
+    }
+
+    void LockQueue() {
+        while (queue_locked_.exchange(true, std::memory_order::acquire)) {
+            while (queue_locked_.load(std::memory_order::relaxed)) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void UnlockQueue() {
+        queue_locked_.store(false, std::memory_order::release);
     }
 };
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "mutex.h"
+
+#include <atomic>
+#include <system_error>
+
+// Priority-inheritance mutex. The word holds the owner thread id, so the uncontended
+// Lock and Unlock are a single CAS each; under contention the kernel queues the waiters
+// by priority (FUTEX_LOCK_PI) and lends the highest waiting priority to the owner,
+// so a low-priority owner cannot be preempted indefinitely by medium-priority threads.
+class PiMutex {
+public:
+    void Lock() {
+        if (!TryLock()) {
+            if (auto error = FutexLockPi(&word_)) {
+                throw std::system_error{error, std::system_category(), "FUTEX_LOCK_PI"};
+            }
+        }
+    }
+
+    bool TryLock() {
+        int zero = 0;
+        return std::atomic_ref<int>(word_).compare_exchange_strong(
+            zero, ThisThreadId(), std::memory_order::acquire, std::memory_order::relaxed);
+    }
+
+    void Unlock() {
+        // Fails if the kernel has set FUTEX_WAITERS, then it picks the next owner
+        auto tid = ThisThreadId();
+        if (!std::atomic_ref<int>(word_).compare_exchange_strong(
+                tid, 0, std::memory_order::release, std::memory_order::relaxed)) {
+            FutexUnlockPi(&word_);
+        }
+    }
+
+    // BasicLockable
+    // https://en.cppreference.com/w/cpp/named_req/BasicLockable
+
+    void lock() {
+        Lock();
+    }
+
+    void unlock() {
+        Unlock();
+    }
+
+private:
+    // 0 - unlocked, otherwise the owner thread id, with FUTEX_WAITERS if somebody sleeps
+    int word_{0};
+};
@@ -0,0 +1,226 @@
+#pragma once
+
+#include "mutex.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static_assert(__PTHREAD_MUTEX_HAVE_PREV, "robust lists are doubly linked only on 64-bit glibc");
+
+enum class LockResult {
+    kOk,
+    // The lock is taken, but its previous owner died holding it: repair the data and call
+    // MarkConsistent() before Unlock(), otherwise the mutex becomes not recoverable
+    kOwnerDead,
+    // The lock is not taken and never will be
+    kNotRecoverable,
+};
+
+namespace robust_mutex_detail {
+
+// The robust list of a thread is registered with the kernel by glibc, which walks it when the
+// thread dies and marks the futex words that still hold the thread id as FUTEX_OWNER_DIED.
+// There is only one list per thread, so RobustMutex links itself into the glibc list the same
+// way glibc links a robust pthread_mutex_t: list pointers point to the __next field of an entry,
+// and the futex word sits at the same offset from it as the __lock field of pthread_mutex_t.
+class ThreadRobustList {
+public:
+    static constexpr ptrdiff_t kFutexOffset =
+        static_cast<ptrdiff_t>(offsetof(pthread_mutex_t, __data.__lock)) -
+        static_cast<ptrdiff_t>(offsetof(pthread_mutex_t, __data.__list.__next));
+
+    static ThreadRobustList& Get() {
+        static const bool at_fork_registered = [] {
+            pthread_atfork(nullptr, nullptr, [] { Instance() = ThreadRobustList{}; });
+            return true;
+        }();
+        static_cast<void>(at_fork_registered);
+        auto& list = Instance();
+        if (!list.head_) {
+            list.Init();
+        }
+        return list;
+    }
+
+    // The kernel looks at the pending entry too, so a thread that dies in the middle of
+    // taking or releasing a lock is covered
+    void SetPending(__pthread_list_t* entry) {
+        head_->list_op_pending = entry ? AsRobust(&entry->__next) : nullptr;
+        std::atomic_signal_fence(std::memory_order::seq_cst);
+    }
+
+    void Push(__pthread_list_t* entry) {
+        auto* first = head_->list.next;
+        EntryOf(first)->__prev = reinterpret_cast<__pthread_list_t*>(&entry->__next);
+        entry->__next = reinterpret_cast<__pthread_list_t*>(first);
+        entry->__prev = reinterpret_cast<__pthread_list_t*>(&head_->list);
+        std::atomic_signal_fence(std::memory_order::seq_cst);
+        head_->list.next = AsRobust(&entry->__next);
+    }
+
+    void Remove(__pthread_list_t* entry) {
+        EntryOf(entry->__next)->__prev = entry->__prev;
+        EntryOf(entry->__prev)->__next = entry->__next;
+        std::atomic_signal_fence(std::memory_order::seq_cst);
+        entry->__prev = nullptr;
+        entry->__next = nullptr;
+    }
+
+private:
+    // Like glibc, keep a __prev slot right in front of the head, so that the head looks
+    // like an entry to Push and Remove
+    struct OwnHead {
+        void* prev = nullptr;
+        robust_list_head head;
+    };
+
+    static ThreadRobustList& Instance() {
+        static thread_local ThreadRobustList list;
+        return list;
+    }
+
+    static robust_list* AsRobust(void* next_field) {
+        return static_cast<robust_list*>(next_field);
+    }
+
+    // Pointers may carry a flag in the lowest bit (set by glibc for PI mutexes)
+    static __pthread_list_t* EntryOf(void* next_field) {
+        auto address = reinterpret_cast<uintptr_t>(next_field) & ~uintptr_t{1};
+        return reinterpret_cast<__pthread_list_t*>(address - offsetof(__pthread_list_t, __next));
+    }
+
+    void Init() {
+        size_t size = 0;
+        syscall(SYS_get_robust_list, 0, &head_, &size);
+        if (!head_) {
+            own_head_.head.list.next = &own_head_.head.list;
+            own_head_.head.futex_offset = kFutexOffset;
+            own_head_.head.list_op_pending = nullptr;
+            if (syscall(SYS_set_robust_list, &own_head_.head, sizeof(own_head_.head)) != 0) {
+                throw std::runtime_error{"set_robust_list failed"};
+            }
+            head_ = &own_head_.head;
+        }
+        if (head_->futex_offset != kFutexOffset) {
+            head_ = nullptr;
+            throw std::runtime_error{"unexpected robust list layout"};
+        }
+    }
+
+    robust_list_head* head_ = nullptr;
+    OwnHead own_head_;
+};
+
+}  // namespace robust_mutex_detail
+
+// Mutex for memory shared between processes, e.g. a shm_open or MAP_SHARED mapping.
+// Construct it once in the shared memory (placement new), then every process can use it.
+// The futex word follows the kernel robust futex protocol: owner thread id, FUTEX_WAITERS
+// if somebody may sleep, FUTEX_OWNER_DIED set by the kernel when the owner dies.
+class RobustMutex {
+public:
+    RobustMutex() {
+        static_assert(offsetof(RobustMutex, link_) + offsetof(__pthread_list_t, __next) -
+                          offsetof(RobustMutex, word_) ==
+                      -robust_mutex_detail::ThreadRobustList::kFutexOffset);
+    }
+
+    RobustMutex(const RobustMutex&) = delete;
+    RobustMutex& operator=(const RobustMutex&) = delete;
+
+    LockResult Lock() {
+        auto& list = robust_mutex_detail::ThreadRobustList::Get();
+        auto tid = ThisThreadId();
+        auto word_atm = std::atomic_ref<int>(word_);
+        auto slept = false;
+        list.SetPending(&link_);
+        auto value = 0;
+        if (!word_atm.compare_exchange_strong(value, tid, std::memory_order::acquire,
+                                              std::memory_order::relaxed)) {
+            while (true) {
+                if ((value & kTidMask) == kNotRecoverable) {
+                    list.SetPending(nullptr);
+                    return LockResult::kNotRecoverable;
+                }
+                if (!(value & kTidMask)) {
+                    // Free, maybe with FUTEX_OWNER_DIED; after sleeping assume there are other
+                    // sleepers, so that Unlock wakes the next one
+                    auto desired = tid | (slept ? kWaiters : value & kWaiters);
+                    if (word_atm.compare_exchange_weak(value, desired, std::memory_order::acquire,
+                                                       std::memory_order::relaxed)) {
+                        break;
+                    }
+                    continue;
+                }
+                if (!(value & kWaiters) &&
+                    !word_atm.compare_exchange_weak(value, value | kWaiters,
+                                                    std::memory_order::relaxed)) {
+                    continue;
+                }
+                FutexWaitShared(&word_, value | kWaiters);
+                slept = true;
+                value = word_atm.load(std::memory_order::relaxed);
+            }
+        }
+        list.Push(&link_);
+        list.SetPending(nullptr);
+        if (value & kOwnerDied) {
+            consistent_ = false;
+            return LockResult::kOwnerDead;
+        }
+        return LockResult::kOk;
+    }
+
+    // Called by the owner after Lock() returned kOwnerDead and the data was repaired
+    void MarkConsistent() {
+        consistent_ = true;
+    }
+
+    void Unlock() {
+        auto& list = robust_mutex_detail::ThreadRobustList::Get();
+        list.SetPending(&link_);
+        list.Remove(&link_);
+        auto new_value = consistent_ ? 0 : kNotRecoverable;
+        auto old = std::atomic_ref<int>(word_).exchange(new_value, std::memory_order::release);
+        list.SetPending(nullptr);
+        if (!consistent_) {
+            FutexWakeShared(&word_, -1);
+        } else if (old & kWaiters) {
+            FutexWakeShared(&word_, 1);
+        }
+    }
+
+    // BasicLockable, for owners that never die
+    // https://en.cppreference.com/w/cpp/named_req/BasicLockable
+
+    void lock() {
+        if (Lock() != LockResult::kOk) {
+            throw std::runtime_error{"owner of RobustMutex died"};
+        }
+    }
+
+    void unlock() {
+        Unlock();
+    }
+
+private:
+    static constexpr int kWaiters = static_cast<int>(FUTEX_WAITERS);
+    static constexpr int kOwnerDied = FUTEX_OWNER_DIED;
+    static constexpr int kTidMask = FUTEX_TID_MASK;
+    // Thread ids never get this large (the kernel limit is 2^22)
+    static constexpr int kNotRecoverable = kTidMask;
+
+    int word_{0};
+    // Written only by the owner
+    bool consistent_ = true;
+    // Padding up to the place of __list in pthread_mutex_t
+    std::byte reserved_[offsetof(pthread_mutex_t, __data.__list) - sizeof(int) - sizeof(bool)];
+    __pthread_list_t link_{};
+};
@@ -1,16 +1,34 @@
 #include "mutex.h"
+#include "condvar.h"
+#include "robust_mutex.h"
+#include "pi_mutex.h"
 #include "runner.h"
+#include "../lock-bench/matrix.h"
 
 #include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include <catch2/catch_test_macros.hpp>
 
 using namespace std::chrono_literals;
 
-static void Run(uint32_t num_threads, std::chrono::steady_clock::duration time) {
+static auto Measure(uint32_t num_threads, int max_spins = Mutex::kDefaultMaxSpins) {
     auto counter = 0;
-    Mutex mutex;
+    Mutex mutex{max_spins};
     TimeRunner runner{1s};
     for (auto i = 0u; i < num_threads; ++i) {
         runner.Do([&] {
@@ -19,8 +37,12 @@ static void Run(uint32_t num_threads, std::chrono::steady_clock::duration time)
             mutex.Unlock();
         });
     }
+    return runner.Wait();
+}
+
+static void Run(uint32_t num_threads, std::chrono::steady_clock::duration time) {
     INFO(std::to_string(num_threads));
-    CHECK(runner.Wait() < time);
+    CHECK(Measure(num_threads) < time);
 }
 
 TEST_CASE("Benchmark") {
@@ -29,3 +51,280 @@ TEST_CASE("Benchmark") {
         Run(num_threads, 100ns);
     }
 }
+
+TEST_CASE("AdaptiveSpinning") {
+    for (auto num_threads : {2, 4, 8}) {
+        auto parking = Measure(num_threads, /*max_spins=*/0);
+        auto spinning = Measure(num_threads);
+        std::cout << num_threads << " threads: " << parking.count() << "ns without spinning, "
+                  << spinning.count() << "ns with adaptive spinning" << std::endl;
+    }
+}
+
+// Bounded queue over any mutex and condition variable with the standard interface
+template <class MutexType, class CondVarType>
+class BoundedQueue {
+public:
+    static constexpr size_t kCapacity = 16;
+
+    void Push(int value) {
+        std::unique_lock lock{mutex_};
+        not_full_.wait(lock, [&] { return items_.size() < kCapacity; });
+        items_.push_back(value);
+        lock.unlock();
+        not_empty_.notify_one();
+    }
+
+    int Pop() {
+        std::unique_lock lock{mutex_};
+        not_empty_.wait(lock, [&] { return !items_.empty(); });
+        auto value = items_.front();
+        items_.pop_front();
+        lock.unlock();
+        not_full_.notify_one();
+        return value;
+    }
+
+private:
+    MutexType mutex_;
+    CondVarType not_empty_;
+    CondVarType not_full_;
+    std::deque<int> items_;
+};
+
+template <class MutexType, class CondVarType>
+static void RunProducerConsumer(const std::string& name, int num_producers) {
+    static constexpr auto kNumItems = 200'000;
+    BoundedQueue<MutexType, CondVarType> queue;
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::vector<std::jthread> threads;
+        for (auto i = 0; i < num_producers; ++i) {
+            threads.emplace_back([&] {
+                for (auto j = 0; j < kNumItems / num_producers; ++j) {
+                    queue.Push(j);
+                }
+            });
+            threads.emplace_back([&] {
+                for (auto j = 0; j < kNumItems / num_producers; ++j) {
+                    queue.Pop();
+                }
+            });
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << name << " " << num_producers << "x" << num_producers << ": "
+              << std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / kNumItems
+              << "ns per item" << std::endl;
+}
+
+TEST_CASE("CondVar") {
+    for (auto num_producers : {1, 4}) {
+        RunProducerConsumer<Mutex, CondVar>("Mutex + CondVar", num_producers);
+        RunProducerConsumer<std::mutex, std::condition_variable>(
+            "std::mutex + std::condition_variable", num_producers);
+        RunProducerConsumer<Mutex, std::condition_variable_any>(
+            "Mutex + std::condition_variable_any", num_producers);
+    }
+}
+
+// Every thread holds the mutex for a while and reports how long each Lock() took
+static void RunWaitTimes(const std::string& name, std::chrono::nanoseconds starvation_threshold,
+                         uint32_t num_threads) {
+    Mutex mutex{Mutex::kDefaultMaxSpins, starvation_threshold};
+    std::vector<LatencyHistogram> latencies(num_threads);
+    std::atomic<bool> stop = false;
+    {
+        std::vector<std::jthread> threads;
+        for (auto i = 0u; i < num_threads; ++i) {
+            threads.emplace_back([&, i] {
+                while (!stop.load(std::memory_order::relaxed)) {
+                    auto start = std::chrono::steady_clock::now();
+                    mutex.Lock();
+                    auto wait_time = std::chrono::steady_clock::now() - start;
+                    BurnCycles(10'000);
+                    mutex.Unlock();
+                    latencies[i].Record(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(wait_time).count());
+                    BurnCycles(1'000);
+                }
+            });
+        }
+        std::this_thread::sleep_for(1s);
+        stop.store(true);
+    }
+    LatencyHistogram total;
+    for (const auto& latency : latencies) {
+        total.Merge(latency);
+    }
+    std::cout << name << " " << num_threads << " threads: " << total.Count() << " locks, wait p50 "
+              << total.Percentile(0.5) << "ns, p99 " << total.Percentile(0.99) << "ns, p99.9 "
+              << total.Percentile(0.999) << "ns, max " << total.Percentile(1) << "ns" << std::endl;
+}
+
+TEST_CASE("StarvationMode") {
+    for (auto num_threads : {4u, 16u}) {
+        RunWaitTimes("barging", Mutex::kNoStarvationMode, num_threads);
+        RunWaitTimes("starvation mode", Mutex::kDefaultStarvationThreshold, num_threads);
+    }
+}
+
+class PthreadRobustMutex {
+public:
+    PthreadRobustMutex() {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init(&mutex_, &attr);
+        pthread_mutexattr_destroy(&attr);
+    }
+
+    ~PthreadRobustMutex() {
+        pthread_mutex_destroy(&mutex_);
+    }
+
+    void lock() {
+        pthread_mutex_lock(&mutex_);
+    }
+
+    void unlock() {
+        pthread_mutex_unlock(&mutex_);
+    }
+
+private:
+    pthread_mutex_t mutex_;
+};
+
+// Forked processes increment a counter in shm_open memory under the lock
+template <class Lock>
+static void RunProcesses(const std::string& name, int num_processes) {
+    static constexpr auto kNumIterations = 200'000;
+    struct Shared {
+        Lock lock;
+        int64_t counter = 0;
+    };
+    const auto* path = "/cpp-cosplays-mutex-bench";
+    auto fd = shm_open(path, O_CREAT | O_RDWR, 0600);
+    REQUIRE(fd >= 0);
+    shm_unlink(path);
+    REQUIRE(ftruncate(fd, sizeof(Shared)) == 0);
+    auto* memory = mmap(nullptr, sizeof(Shared), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    REQUIRE(memory != MAP_FAILED);
+    auto* shared = new (memory) Shared;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<pid_t> children;
+    for (auto i = 0; i < num_processes; ++i) {
+        auto pid = fork();
+        if (pid == 0) {
+            for (auto j = 0; j < kNumIterations; ++j) {
+                std::lock_guard guard{shared->lock};
+                ++shared->counter;
+            }
+            _exit(0);
+        }
+        children.push_back(pid);
+    }
+    for (auto pid : children) {
+        waitpid(pid, nullptr, 0);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    CHECK(shared->counter == int64_t{kNumIterations} * num_processes);
+    std::cout << name << " " << num_processes << " processes: "
+              << std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() /
+                     (int64_t{kNumIterations} * num_processes)
+              << "ns per lock" << std::endl;
+    shared->~Shared();
+    munmap(memory, sizeof(Shared));
+}
+
+TEST_CASE("ProcessShared") {
+    for (auto num_processes : {1, 2, 4, 8}) {
+        RunProcesses<RobustMutex>("RobustMutex", num_processes);
+        RunProcesses<PthreadRobustMutex>("robust pthread_mutex_t", num_processes);
+    }
+}
+
+static std::chrono::nanoseconds ThreadCpuTime() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::chrono::seconds{ts.tv_sec} + std::chrono::nanoseconds{ts.tv_nsec};
+}
+
+static void BurnCpu(std::chrono::nanoseconds duration) {
+    auto end = ThreadCpuTime() + duration;
+    while (ThreadCpuTime() < end) {
+    }
+}
+
+// Puts the calling thread on the first CPU the process may use and, if allowed,
+// into SCHED_FIFO with the given priority
+static bool SetUpThread(int priority) {
+    cpu_set_t allowed;
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    auto cpu = 0;
+    while (!CPU_ISSET(cpu, &allowed)) {
+        ++cpu;
+    }
+    cpu_set_t one;
+    CPU_ZERO(&one);
+    CPU_SET(cpu, &one);
+    pthread_setaffinity_np(pthread_self(), sizeof(one), &one);
+    sched_param param{.sched_priority = priority};
+    return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+}
+
+// Classic inversion on one CPU: a low-priority thread takes the lock for 20ms of CPU time,
+// a high-priority thread blocks on it, then a medium-priority thread burns 200ms of CPU.
+// Without priority inheritance the medium thread preempts the owner and the high thread
+// waits for both; with it the owner runs at high priority and the wait is about 20ms.
+template <class Lock>
+static std::chrono::nanoseconds MeasureHighPriorityWait(bool& realtime) {
+    using namespace std::chrono_literals;
+    Lock lock;
+    std::atomic<int> num_realtime = 0;
+    std::chrono::nanoseconds wait_time{};
+    auto start = std::chrono::steady_clock::now() + 50ms;
+    {
+        std::jthread low{[&] {
+            num_realtime += SetUpThread(10);
+            std::this_thread::sleep_until(start);
+            lock.lock();
+            BurnCpu(20ms);
+            lock.unlock();
+        }};
+        std::jthread high{[&] {
+            num_realtime += SetUpThread(30);
+            std::this_thread::sleep_until(start + 5ms);
+            auto begin = std::chrono::steady_clock::now();
+            lock.lock();
+            wait_time = std::chrono::steady_clock::now() - begin;
+            lock.unlock();
+        }};
+        std::jthread medium{[&] {
+            num_realtime += SetUpThread(20);
+            std::this_thread::sleep_until(start + 10ms);
+            BurnCpu(200ms);
+        }};
+    }
+    realtime = num_realtime == 3;
+    return wait_time;
+}
+
+TEST_CASE("PriorityInversion") {
+    auto realtime_without_pi = false;
+    auto realtime_with_pi = false;
+    auto without_pi = MeasureHighPriorityWait<Mutex>(realtime_without_pi);
+    auto with_pi = MeasureHighPriorityWait<PiMutex>(realtime_with_pi);
+    // Waits measured with normal priorities show no inversion and are not comparable
+    if (!realtime_without_pi || !realtime_with_pi) {
+        std::cout << "SCHED_FIFO is not permitted (needs CAP_SYS_NICE or an RLIMIT_RTPRIO), "
+                     "threads ran with normal priorities, so there is no inversion to show"
+                  << std::endl;
+        return;
+    }
+    std::cout << "high-priority wait: Mutex " << without_pi.count() / 1'000 << "us, PiMutex "
+              << with_pi.count() / 1'000 << "us" << std::endl;
+}
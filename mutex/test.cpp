@@ -1,4 +1,7 @@
 #include "mutex.h"
+#include "condvar.h"
+#include "robust_mutex.h"
+#include "pi_mutex.h"
 #include "util.h"
 
 #include <thread>
@@ -7,8 +10,13 @@
 #include <cstring>
 #include <chrono>
 #include <vector>
+#include <deque>
+#include <memory>
 
+#include <sys/mman.h>
 #include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include <catch2/catch_test_macros.hpp>
 
@@ -56,6 +64,120 @@ TEST_CASE("Counter") {
     CHECK(counter == kNumThreads * kNumIterations);
 }
 
+TEST_CASE("ShortCriticalSections") {
+    static constexpr auto kNumIterations = 100'000;
+    static constexpr auto kNumThreads = 4;
+    for (auto max_spins : {0, Mutex::kDefaultMaxSpins}) {
+        auto counter = 0;
+        Mutex mutex{max_spins};
+        std::vector<std::jthread> threads;
+        for (auto i = 0; i < kNumThreads; ++i) {
+            threads.emplace_back([&] {
+                for (auto j = 0; j < kNumIterations; ++j) {
+                    mutex.Lock();
+                    ++counter;
+                    mutex.Unlock();
+                    if (j % 100 == 0) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        threads.clear();
+        CHECK(counter == kNumThreads * kNumIterations);
+    }
+}
+
+TEST_CASE("StarvationMode") {
+    static constexpr auto kNumIterations = 20'000;
+    static constexpr auto kNumThreads = 8;
+    for (auto threshold : {Mutex::kNoStarvationMode, 0ns, Mutex::kDefaultStarvationThreshold}) {
+        auto counter = 0;
+        Mutex mutex{Mutex::kDefaultMaxSpins, threshold};
+        std::vector<std::jthread> threads;
+        for (auto i = 0; i < kNumThreads; ++i) {
+            threads.emplace_back([&] {
+                for (auto j = 0; j < kNumIterations; ++j) {
+                    mutex.Lock();
+                    ++counter;
+                    if (j % 1'000 == 0) {
+                        std::this_thread::sleep_for(10us);
+                    }
+                    mutex.Unlock();
+                }
+            });
+        }
+        threads.clear();
+        CHECK(counter == kNumThreads * kNumIterations);
+    }
+}
+
+TEST_CASE("NoStarvation") {
+    static constexpr auto kNumHogs = 4;
+    Mutex mutex;
+    std::atomic<bool> stop = false;
+    std::vector<std::jthread> hogs;
+    for (auto i = 0; i < kNumHogs; ++i) {
+        hogs.emplace_back([&] {
+            while (!stop.load()) {
+                mutex.Lock();
+                std::this_thread::sleep_for(100us);
+                mutex.Unlock();
+            }
+        });
+    }
+    std::this_thread::sleep_for(50ms);
+    for (auto i = 0; i < 10; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        mutex.Lock();
+        auto wait_time = std::chrono::steady_clock::now() - start;
+        mutex.Unlock();
+        // Bounded by the threshold plus the critical sections of the waiters queued earlier
+        CHECK(wait_time < 100ms);
+    }
+    stop.store(true);
+}
+
+// Waiters turn starving at once, so the handoff queue is in use all the time. A lost handoff
+// leaves a waiter asleep for good: the threads are then left behind and the test fails
+TEST_CASE("StarvationHandOff") {
+    static constexpr auto kNumRounds = 20;
+    static constexpr auto kNumThreads = 4;
+    static constexpr auto kNumIterations = 2'000;
+    struct State {
+        Mutex mutex{Mutex::kDefaultMaxSpins, 0ns};
+        int counter = 0;
+        std::atomic<int> num_done = 0;
+    };
+    for (auto round = 0; round < kNumRounds; ++round) {
+        // Shared with the threads, which outlive the test if they hang
+        auto state = std::make_shared<State>();
+        std::vector<std::jthread> threads;
+        for (auto i = 0; i < kNumThreads; ++i) {
+            threads.emplace_back([state] {
+                for (auto j = 0; j < kNumIterations; ++j) {
+                    state->mutex.Lock();
+                    ++state->counter;
+                    state->mutex.Unlock();
+                }
+                ++state->num_done;
+            });
+        }
+        auto start = std::chrono::steady_clock::now();
+        while (state->num_done < kNumThreads && std::chrono::steady_clock::now() - start < 10s) {
+            std::this_thread::sleep_for(1ms);
+        }
+        if (state->num_done < kNumThreads) {
+            for (auto& thread : threads) {
+                thread.detach();
+            }
+            FAIL("a waiter was never handed the lock in round " << round);
+        }
+        threads.clear();
+        REQUIRE(state->counter == kNumThreads * kNumIterations);
+    }
+}
+
 TEST_CASE("Spinlock") {
     Mutex mutex;
     std::atomic_flag holder_is_ready;
@@ -81,3 +203,191 @@ TEST_CASE("Spinlock") {
         mutex.Unlock();
     }};
 }
+
+TEST_CASE("CondVar") {
+    static constexpr auto kNumItems = 100'000;
+    static constexpr auto kNumConsumers = 4;
+    static constexpr size_t kCapacity = 8;
+    Mutex mutex;
+    CondVar not_empty;
+    CondVar not_full;
+    std::deque<int> items;
+    std::atomic<int64_t> sum = 0;
+    {
+        std::vector<std::jthread> threads;
+        for (auto i = 0; i < kNumConsumers; ++i) {
+            threads.emplace_back([&] {
+                while (true) {
+                    mutex.Lock();
+                    not_empty.Wait(mutex, [&] { return !items.empty(); });
+                    auto item = items.front();
+                    items.pop_front();
+                    mutex.Unlock();
+                    not_full.NotifyOne();
+                    if (item < 0) {
+                        break;
+                    }
+                    sum += item;
+                }
+            });
+        }
+        for (auto i = 1; i <= kNumItems + kNumConsumers; ++i) {
+            std::unique_lock lock{mutex};
+            not_full.wait(lock, [&] { return items.size() < kCapacity; });
+            items.push_back(i <= kNumItems ? i : -1);
+            lock.unlock();
+            not_empty.notify_one();
+        }
+    }
+    CHECK(sum == int64_t{kNumItems} * (kNumItems + 1) / 2);
+}
+
+TEST_CASE("CondVarNotifyAll") {
+    static constexpr auto kNumWaiters = 16;
+    Mutex mutex;
+    CondVar cv;
+    auto ready = false;
+    auto num_woken = 0;
+    std::vector<std::jthread> threads;
+    for (auto i = 0; i < kNumWaiters; ++i) {
+        threads.emplace_back([&] {
+            mutex.Lock();
+            cv.Wait(mutex, [&] { return ready; });
+            ++num_woken;
+            mutex.Unlock();
+        });
+    }
+    std::this_thread::sleep_for(100ms);
+    mutex.Lock();
+    ready = true;
+    cv.NotifyAll();
+    mutex.Unlock();
+    threads.clear();
+    CHECK(num_woken == kNumWaiters);
+}
+
+TEST_CASE("CondVarTimeout") {
+    Mutex mutex;
+    CondVar cv;
+    mutex.Lock();
+    auto start = std::chrono::steady_clock::now();
+    CHECK(cv.WaitFor(mutex, 100ms) == std::cv_status::timeout);
+    auto diff = std::chrono::steady_clock::now() - start;
+    CHECK(diff >= 100ms);
+    CHECK(diff < 300ms);
+    CHECK_FALSE(cv.WaitUntil(mutex, std::chrono::steady_clock::now() + 50ms, [] { return false; }));
+    mutex.Unlock();
+
+    auto done = false;
+    std::jthread notifier{[&] {
+        std::this_thread::sleep_for(50ms);
+        mutex.Lock();
+        done = true;
+        cv.NotifyOne();
+        mutex.Unlock();
+    }};
+    mutex.Lock();
+    CHECK(cv.WaitFor(mutex, 10s, [&] { return done; }));
+    mutex.Unlock();
+}
+
+TEST_CASE("RobustMutex") {
+    static constexpr auto kNumIterations = 100'000;
+    static constexpr auto kNumThreads = 4;
+    auto counter = 0;
+    RobustMutex mutex;
+    std::vector<std::jthread> threads;
+    for (auto i = 0; i < kNumThreads; ++i) {
+        threads.emplace_back([&] {
+            for (auto j = 0; j < kNumIterations; ++j) {
+                std::lock_guard guard{mutex};
+                ++counter;
+            }
+        });
+    }
+    threads.clear();
+    CHECK(counter == kNumThreads * kNumIterations);
+
+    // The kernel cleans up after an exited thread as well as after a dead process
+    std::jthread{[&] { CHECK(mutex.Lock() == LockResult::kOk); }}.join();
+    CHECK(mutex.Lock() == LockResult::kOwnerDead);
+    mutex.MarkConsistent();
+    mutex.Unlock();
+    CHECK(mutex.Lock() == LockResult::kOk);
+    mutex.Unlock();
+}
+
+TEST_CASE("RobustMutexOwnerDead") {
+    auto* memory = mmap(nullptr, sizeof(RobustMutex), PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    REQUIRE(memory != MAP_FAILED);
+    auto* mutex = new (memory) RobustMutex;
+    auto die_holding_lock = [&] {
+        auto pid = fork();
+        if (pid == 0) {
+            mutex->Lock();
+            _exit(0);
+        }
+        waitpid(pid, nullptr, 0);
+    };
+
+    die_holding_lock();
+    CHECK(mutex->Lock() == LockResult::kOwnerDead);
+    mutex->MarkConsistent();
+    mutex->Unlock();
+
+    // A waiter in another process is woken when the owner dies
+    std::atomic_flag locked;
+    std::jthread owner{[&] {
+        mutex->Lock();
+        locked.test_and_set();
+        locked.notify_one();
+        std::this_thread::sleep_for(200ms);
+    }};
+    locked.wait(false);
+    auto pid = fork();
+    if (pid == 0) {
+        auto result = mutex->Lock();
+        mutex->MarkConsistent();
+        mutex->Unlock();
+        _exit(result == LockResult::kOwnerDead ? 0 : 1);
+    }
+    owner.join();
+    int status = 0;
+    waitpid(pid, &status, 0);
+    CHECK(WIFEXITED(status));
+    CHECK(WEXITSTATUS(status) == 0);
+    CHECK(mutex->Lock() == LockResult::kOk);
+    mutex->Unlock();
+
+    // Not marking the mutex consistent makes it unusable
+    die_holding_lock();
+    CHECK(mutex->Lock() == LockResult::kOwnerDead);
+    mutex->Unlock();
+    CHECK(mutex->Lock() == LockResult::kNotRecoverable);
+    munmap(memory, sizeof(RobustMutex));
+}
+
+TEST_CASE("PiMutex") {
+    static constexpr auto kNumIterations = 100'000;
+    static constexpr auto kNumThreads = 4;
+    auto counter = 0;
+    PiMutex mutex;
+    std::vector<std::jthread> threads;
+    for (auto i = 0; i < kNumThreads; ++i) {
+        threads.emplace_back([&] {
+            for (auto j = 0; j < kNumIterations; ++j) {
+                std::lock_guard guard{mutex};
+                ++counter;
+            }
+        });
+    }
+    threads.clear();
+    CHECK(counter == kNumThreads * kNumIterations);
+
+    mutex.Lock();
+    std::jthread{[&] { CHECK_FALSE(mutex.TryLock()); }}.join();
+    mutex.Unlock();
+    CHECK(mutex.TryLock());
+    mutex.Unlock();
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include <sched.h>
+
+// Read-mostly RW-lock (the "big reader" lock): a reader only touches the cache line of
+// a per-CPU slot, so readers on different CPUs never contend. A writer raises a flag,
+// which turns new readers away, and then waits for every slot to drain.
+//
+// Readers increment their slot and then check the flag, a writer raises the flag and
+// then checks the slots, both with seq_cst, so at least one of them sees the other.
+class BigReaderLock {
+public:
+    static constexpr size_t kNumSlots = 64;
+
+    void Read(auto func) {
+        auto& slot = slots_[CurrentSlot()];
+        while (true) {
+            slot.readers.fetch_add(1);
+            if (!writer_.load()) {
+                break;
+            }
+            EndRead(slot);
+            writer_.wait(true);
+        }
+        try {
+            func();
+        } catch (...) {
+            EndRead(slot);
+            throw;
+        }
+        EndRead(slot);
+    }
+
+    void Write(auto func) {
+        // The flag also keeps writers out of each other's way
+        while (writer_.exchange(true)) {
+            writer_.wait(true);
+        }
+        for (size_t i = 0; i < kNumSlots; ++i) {
+            auto& readers = slots_[i].readers;
+            for (auto value = readers.load(); value; value = readers.load()) {
+                readers.wait(value);
+            }
+        }
+        try {
+            func();
+        } catch (...) {
+            EndWrite();
+            throw;
+        }
+        EndWrite();
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint32_t> readers{0};
+    };
+
+    // The slot is remembered for the matching EndRead, so migrating to another CPU
+    // in between is harmless
+    static size_t CurrentSlot() {
+        auto cpu = sched_getcpu();
+        return cpu < 0 ? 0 : static_cast<size_t>(cpu) % kNumSlots;
+    }
+
+    void EndRead(Slot& slot) {
+        if (slot.readers.fetch_sub(1) == 1 && writer_.load()) {
+            slot.readers.notify_all();
+        }
+    }
+
+    void EndWrite() {
+        writer_.store(false);
+        writer_.notify_all();
+    }
+
+    std::unique_ptr<Slot[]> slots_ = std::make_unique<Slot[]>(kNumSlots);
+    alignas(64) std::atomic<bool> writer_{false};
+};
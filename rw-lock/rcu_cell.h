@@ -0,0 +1,97 @@
+#pragma once
+
+#include "../mutex/mutex.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <sched.h>
+
+// Read-copy-update cell for read-mostly values: readers follow a pointer inside a read-side
+// section that only touches a per-CPU counter, a writer publishes a new value and deletes
+// the old one after a grace period, once every reader that could have seen it has left.
+//
+// Readers count themselves in the counter of the current epoch parity (as in Linux SRCU).
+// A grace period flips the parity and waits for the counters of the old parity to drain,
+// twice: a reader that read the parity just before a flip may count itself in only after it.
+template <class T>
+class RcuCell {
+public:
+    static constexpr size_t kNumSlots = 64;
+
+    explicit RcuCell(std::unique_ptr<T> value) : value_{value.release()} {
+    }
+
+    RcuCell(const RcuCell&) = delete;
+    RcuCell& operator=(const RcuCell&) = delete;
+
+    ~RcuCell() {
+        delete value_.load();
+    }
+
+    // func(const T&) must not keep the reference after it returns
+    decltype(auto) Read(auto func) const {
+        auto& slot = slots_[CurrentSlot()];
+        auto parity = epoch_.load(std::memory_order::acquire) & 1;
+        slot.readers[parity].fetch_add(1, std::memory_order::relaxed);
+        // Either the grace period sees the counter, or we see the new value
+        std::atomic_thread_fence(std::memory_order::seq_cst);
+        const auto* value = value_.load(std::memory_order::acquire);
+        struct ExitSection {
+            ~ExitSection() {
+                counter.fetch_sub(1, std::memory_order::release);
+            }
+            std::atomic<uint64_t>& counter;
+        } exit_section{slot.readers[parity]};
+        return func(*value);
+    }
+
+    // Publishes value and deletes the old one once no reader can see it
+    void Store(std::unique_ptr<T> value) {
+        std::lock_guard guard{writer_mutex_};
+        std::unique_ptr<T> old{value_.exchange(value.release(), std::memory_order::acq_rel)};
+        Synchronize();
+    }
+
+    // Copies the value, lets func(T&) change the copy and publishes it
+    void Update(auto func) {
+        std::lock_guard guard{writer_mutex_};
+        auto value = std::make_unique<T>(*value_.load(std::memory_order::relaxed));
+        func(*value);
+        std::unique_ptr<T> old{value_.exchange(value.release(), std::memory_order::acq_rel)};
+        Synchronize();
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::array<std::atomic<uint64_t>, 2> readers{};
+    };
+
+    // The slot is remembered for the end of the section, so migrating in between is harmless
+    static size_t CurrentSlot() {
+        auto cpu = sched_getcpu();
+        return cpu < 0 ? 0 : static_cast<size_t>(cpu) % kNumSlots;
+    }
+
+    // Called by the writer
+    void Synchronize() {
+        for (auto i = 0; i < 2; ++i) {
+            auto parity = epoch_.fetch_add(1, std::memory_order::acq_rel) & 1;
+            std::atomic_thread_fence(std::memory_order::seq_cst);
+            for (size_t j = 0; j < kNumSlots; ++j) {
+                while (slots_[j].readers[parity].load(std::memory_order::acquire)) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    }
+
+    std::atomic<T*> value_;
+    alignas(64) std::atomic<uint64_t> epoch_{0};
+    std::unique_ptr<Slot[]> slots_ = std::make_unique<Slot[]>(kNumSlots);
+    Mutex writer_mutex_;
+};
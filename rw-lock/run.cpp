@@ -1,7 +1,23 @@
 #include "rw_lock.h"
+#include "big_reader_lock.h"
+#include "seqlock.h"
+#include "rcu_cell.h"
 #include "runner.h"
+#include "../lock-bench/matrix.h"
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
 #include <ranges>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/resource.h>
 
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/benchmark/catch_benchmark.hpp>
@@ -39,9 +55,10 @@ int64_t BinPow(int64_t a, int64_t b, int64_t mod) {
     }
 }
 
+template <class Lock = RWLock>
 uint64_t RunBenchmark(uint32_t num_threads, uint32_t num_readers, uint64_t counter = 0) {
     static constexpr auto kPrime = 100'000'000'000'000'003ll;
-    RWLock rw_lock;
+    Lock rw_lock;
     Runner runner{kNumIterations};
     for (auto i = 0u; i < num_readers; ++i) {
         runner.Do([&] {
@@ -59,6 +76,244 @@ uint64_t RunBenchmark(uint32_t num_threads, uint32_t num_readers, uint64_t count
     return counter;
 }
 
+// Read-only throughput, in millions of reads per second, for 1, 2, 4, ... threads
+template <class Lock>
+void RunReadScaling(const std::string& name) {
+    using namespace std::chrono_literals;
+    auto max_threads = std::max(4u, std::thread::hardware_concurrency());
+    for (auto num_threads = 1u; num_threads <= max_threads; num_threads *= 2) {
+        Lock rw_lock;
+        auto value = 0;
+        TimeRunner runner{500ms};
+        for (auto i = 0u; i < num_threads; ++i) {
+            runner.Do([&] { rw_lock.Read([&] { static_cast<void>(std::as_const(value)); }); });
+        }
+        auto time_per_read = runner.Wait();
+        std::cout << name << " " << num_threads << " threads: "
+                  << 1'000.0 / static_cast<double>(time_per_read.count()) << "M reads/s"
+                  << std::endl;
+    }
+}
+
+// Voluntary and involuntary context switches of the whole process so far
+uint64_t ContextSwitches() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<uint64_t>(usage.ru_nvcsw + usage.ru_nivcsw);
+}
+
+// The "Reads" scenario for a second: 2 writers among readers that keep the lock busy,
+// reports how long each Write() waited to get in
+template <class Lock>
+void RunWriterLatency(const std::string& name, uint32_t num_threads) {
+    using namespace std::chrono_literals;
+    static constexpr auto kNumWriters = 2u;
+    Lock rw_lock;
+    std::vector<LatencyHistogram> latencies(kNumWriters);
+    std::atomic<uint64_t> num_reads = 0;
+    std::atomic<bool> stop = false;
+    auto start_switches = ContextSwitches();
+    {
+        std::vector<std::jthread> threads;
+        for (auto i = 0u; i < kNumWriters; ++i) {
+            threads.emplace_back([&, i] {
+                while (!stop.load(std::memory_order::relaxed)) {
+                    auto start = std::chrono::steady_clock::now();
+                    std::chrono::steady_clock::duration wait_time;
+                    rw_lock.Write([&] {
+                        wait_time = std::chrono::steady_clock::now() - start;
+                        BurnCycles(1'000);
+                    });
+                    latencies[i].Record(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(wait_time).count());
+                    BurnCycles(10'000);
+                }
+            });
+        }
+        for (auto i = kNumWriters; i < num_threads; ++i) {
+            threads.emplace_back([&] {
+                while (!stop.load(std::memory_order::relaxed)) {
+                    rw_lock.Read([] { BurnCycles(10'000); });
+                    num_reads.fetch_add(1, std::memory_order::relaxed);
+                }
+            });
+        }
+        std::this_thread::sleep_for(1s);
+        stop.store(true);
+    }
+    auto switches = ContextSwitches() - start_switches;
+    LatencyHistogram total;
+    for (const auto& latency : latencies) {
+        total.Merge(latency);
+    }
+    auto num_ops = num_reads.load() + total.Count();
+    std::cout << name << " " << num_threads << " threads: " << num_reads.load() << " reads, "
+              << total.Count() << " writes, writer wait p50 " << total.Percentile(0.5)
+              << "ns, p99 " << total.Percentile(0.99) << "ns, max " << total.Percentile(1)
+              << "ns, " << static_cast<double>(switches) / static_cast<double>(num_ops)
+              << " context switches per op" << std::endl;
+}
+
+struct Snapshot {
+    uint64_t version;
+    uint64_t values[3];
+};
+
+// RWLock guarding a Snapshot, with the interface of SeqLock
+class RWLockedSnapshot {
+public:
+    Snapshot Read() {
+        Snapshot snapshot;
+        rw_lock_.Read([&] { snapshot = snapshot_; });
+        return snapshot;
+    }
+
+    void Write(auto func) {
+        rw_lock_.Write([&] { func(snapshot_); });
+    }
+
+private:
+    RWLock rw_lock_;
+    Snapshot snapshot_{};
+};
+
+// Reads of a small struct, in millions per second, with a writer updating it all the time
+// or not at all
+template <class Guarded>
+void RunSnapshotReads(const std::string& name, bool with_writer) {
+    using namespace std::chrono_literals;
+    auto max_threads = std::max(4u, std::thread::hardware_concurrency());
+    for (auto num_threads = 1u; num_threads <= max_threads; num_threads *= 2) {
+        Guarded guarded;
+        std::atomic<bool> stop = false;
+        std::jthread writer;
+        if (with_writer) {
+            writer = std::jthread{[&] {
+                while (!stop.load(std::memory_order::relaxed)) {
+                    guarded.Write([](Snapshot& snapshot) { ++snapshot.version; });
+                }
+            }};
+        }
+        uint64_t versions = 0;
+        TimeRunner runner{500ms};
+        for (auto i = 0u; i < num_threads; ++i) {
+            runner.Do([&] {
+                std::atomic_ref{versions}.fetch_add(guarded.Read().version,
+                                                    std::memory_order::relaxed);
+            });
+        }
+        auto time_per_read = runner.Wait();
+        stop.store(true);
+        std::cout << name << (with_writer ? " with writer " : " ") << num_threads
+                  << " threads: " << 1'000.0 / static_cast<double>(time_per_read.count())
+                  << "M reads/s" << std::endl;
+    }
+}
+
+// Direct-mapped cache: a lookup validates the slot, a miss fills it in.
+// With Read then Write the validation is repeated under the write lock, with
+// ReadUpgradable it is not, but upgradable readers exclude each other
+class CheckThenUpdate {
+public:
+    static constexpr size_t kNumSlots = 256;
+
+    explicit CheckThenUpdate(bool upgradable) : upgradable_{upgradable} {
+    }
+
+    // miss_percent of the lookups are for keys that are not in the cache
+    void Lookup(uint32_t miss_percent) {
+        thread_local std::mt19937 gen{std::random_device{}()};
+        auto hot = std::uniform_int_distribution<uint32_t>{0, 99}(gen) >= miss_percent;
+        auto key = std::uniform_int_distribution<uint64_t>{0, kNumSlots - 1}(gen) +
+                   (hot ? 0 : kNumSlots);
+        auto& slot = slots_[key % kNumSlots];
+        if (upgradable_) {
+            rw_lock_.ReadUpgradable([&](auto& handle) {
+                if (!Validate(slot, key)) {
+                    handle.Upgrade();
+                    slot = key;
+                }
+            });
+            return;
+        }
+        auto hit = true;
+        rw_lock_.Read([&] { hit = Validate(slot, key); });
+        if (!hit) {
+            rw_lock_.Write([&] {
+                if (!Validate(slot, key)) {
+                    slot = key;
+                }
+            });
+        }
+    }
+
+private:
+    static bool Validate(const uint64_t& slot, uint64_t key) {
+        BurnCycles(200);
+        return slot == key;
+    }
+
+    const bool upgradable_;
+    RWLock rw_lock_;
+    std::array<uint64_t, kNumSlots> slots_{};
+};
+
+using Routes = std::vector<uint64_t>;
+
+// RWLock guarding a table, with the interface of RcuCell
+class RWLockedRoutes {
+public:
+    explicit RWLockedRoutes(std::unique_ptr<Routes> routes) : routes_{std::move(*routes)} {
+    }
+
+    uint64_t Read(auto func) {
+        uint64_t result;
+        rw_lock_.Read([&] { result = func(routes_); });
+        return result;
+    }
+
+    void Store(std::unique_ptr<Routes> routes) {
+        rw_lock_.Write([&] { routes_ = std::move(*routes); });
+    }
+
+private:
+    RWLock rw_lock_;
+    Routes routes_;
+};
+
+// Lookups in a routing table, in millions per second, while the table is replaced
+// every 10ms
+template <class Table>
+void RunRouteLookups(const std::string& name) {
+    using namespace std::chrono_literals;
+    static constexpr size_t kNumRoutes = 1024;
+    auto max_threads = std::max(4u, std::thread::hardware_concurrency());
+    for (auto num_threads = 1u; num_threads <= max_threads; num_threads *= 2) {
+        Table table{std::make_unique<Routes>(kNumRoutes)};
+        std::atomic<bool> stop = false;
+        std::jthread writer{[&] {
+            for (uint64_t version = 1; !stop.load(std::memory_order::relaxed); ++version) {
+                table.Store(std::make_unique<Routes>(kNumRoutes, version));
+                std::this_thread::sleep_for(10ms);
+            }
+        }};
+        TimeRunner runner{500ms};
+        for (auto i = 0u; i < num_threads; ++i) {
+            runner.Do([&] {
+                thread_local size_t route = 0;
+                thread_local uint64_t checksum = 0;
+                route = (route + 1) % kNumRoutes;
+                checksum += table.Read([](const Routes& routes) { return routes[route]; });
+            });
+        }
+        auto time_per_lookup = runner.Wait();
+        stop.store(true);
+        std::cout << name << " " << num_threads << " threads: "
+                  << 1'000.0 / static_cast<double>(time_per_lookup.count()) << "M lookups/s"
+                  << std::endl;
+    }
+}
+
 }  // namespace
 
 TEST_CASE("Benchmark") {
@@ -86,3 +341,91 @@ TEST_CASE("Benchmark") {
     };
     REQUIRE(counter < kNumIterations + kInitCounter);
 }
+
+TEST_CASE("BigReader") {
+    auto num_threads = std::max(4u, std::thread::hardware_concurrency());
+    uint64_t counter{};
+
+    static constexpr auto kInitCounter = 67;
+    BENCHMARK("ReadOnly") {
+        counter = RunBenchmark<BigReaderLock>(num_threads, num_threads, kInitCounter);
+    };
+    REQUIRE(counter == kInitCounter);
+
+    BENCHMARK("Half") {
+        counter = RunBenchmark<BigReaderLock>(num_threads, num_threads / 2);
+    };
+    REQUIRE(counter < kNumIterations);
+}
+
+TEST_CASE("ReadScaling") {
+    RunReadScaling<RWLock>("RWLock");
+    RunReadScaling<BigReaderLock>("BigReaderLock");
+}
+
+TEST_CASE("WriterLatency") {
+    for (auto num_threads : {4u, 16u}) {
+        RunWriterLatency<BasicRWLock<ReaderPreferring>>("ReaderPreferring", num_threads);
+        RunWriterLatency<BasicRWLock<WriterPreferring>>("WriterPreferring", num_threads);
+        RunWriterLatency<BasicRWLock<PhaseFair>>("PhaseFair", num_threads);
+    }
+}
+
+TEST_CASE("SeqLock") {
+    for (auto with_writer : {false, true}) {
+        RunSnapshotReads<RWLockedSnapshot>("RWLock", with_writer);
+        RunSnapshotReads<SeqLock<Snapshot>>("SeqLock", with_writer);
+    }
+}
+
+TEST_CASE("CheckThenUpdate") {
+    using namespace std::chrono_literals;
+    auto num_threads = std::max(4u, std::thread::hardware_concurrency());
+    for (auto miss_percent : {1u, 10u, 50u}) {
+        for (auto upgradable : {false, true}) {
+            CheckThenUpdate cache{upgradable};
+            TimeRunner runner{500ms};
+            for (auto i = 0u; i < num_threads; ++i) {
+                runner.Do([&] { cache.Lookup(miss_percent); });
+            }
+            auto time_per_lookup = runner.Wait();
+            std::cout << (upgradable ? "ReadUpgradable " : "Read then Write ") << miss_percent
+                      << "% misses: " << time_per_lookup.count() << "ns per lookup" << std::endl;
+        }
+    }
+}
+
+TEST_CASE("RcuCell") {
+    RunRouteLookups<RWLockedRoutes>("RWLock");
+    RunRouteLookups<RcuCell<Routes>>("RcuCell");
+}
+
+// Uncontended Read and Write, and reads with 4 threads, for each policy, with the 64-bit
+// state word and with a 32-bit one, to check that the wider atomics cost nothing
+template <class Lock>
+void RunFastPaths(const std::string& name) {
+    using namespace std::chrono_literals;
+    Lock rw_lock;
+    auto value = 0;
+    for (auto num_threads : {1u, 4u}) {
+        TimeRunner read_runner{500ms};
+        for (auto i = 0u; i < num_threads; ++i) {
+            read_runner.Do([&] { rw_lock.Read([&] { static_cast<void>(std::as_const(value)); }); });
+        }
+        auto time_per_read = read_runner.Wait();
+        std::cout << name << " " << num_threads << " threads: Read " << time_per_read.count()
+                  << "ns" << std::endl;
+    }
+    TimeRunner write_runner{500ms};
+    write_runner.Do([&] { rw_lock.Write([&] { ++value; }); });
+    std::cout << name << " 1 thread: Write " << write_runner.Wait().count() << "ns" << std::endl;
+}
+
+TEST_CASE("FastPaths") {
+    RunFastPaths<BasicRWLock<ReaderPreferring>>("ReaderPreferring");
+    RunFastPaths<BasicRWLock<ReaderPreferring, uint32_t>>("ReaderPreferring 32-bit");
+    RunFastPaths<BasicRWLock<WriterPreferring>>("WriterPreferring");
+    RunFastPaths<BasicRWLock<WriterPreferring, uint32_t>>("WriterPreferring 32-bit");
+    RunFastPaths<BasicRWLock<PhaseFair>>("PhaseFair");
+    RunFastPaths<BasicRWLock<PhaseFair, uint32_t>>("PhaseFair 32-bit");
+}
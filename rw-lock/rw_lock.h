@@ -1,16 +1,115 @@
 #pragma once
 
+#include "../mutex/mutex.h"
+
 #include <atomic>
+#include <concepts>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+// Fairness policies for BasicRWLock
+
+// Readers get in whenever no writer is active, so a steady stream of readers
+// can keep writers out forever
+struct ReaderPreferring {
+    static constexpr bool kReadersYieldToPendingWriter = false;
+    static constexpr bool kAdmitWaitingReaders = false;
+};
+
+// A waiting writer stops new readers, and the lock goes from writer to writer while
+// they keep coming, so a steady stream of writers can keep readers out forever
+struct WriterPreferring {
+    static constexpr bool kReadersYieldToPendingWriter = true;
+    static constexpr bool kAdmitWaitingReaders = false;
+};
 
-class RWLock {
+// A waiting writer stops new readers, and a leaving writer lets in all readers that
+// arrived while it was pending or active, so readers and writers take turns
+// (Brandenburg, Anderson. Spin-based reader-writer synchronization for multiprocessor
+// real-time systems, 2010)
+struct PhaseFair {
+    static constexpr bool kReadersYieldToPendingWriter = true;
+    static constexpr bool kAdmitWaitingReaders = true;
+};
+
+namespace rw_lock_detail {
+
+// Futex word for one kind of waiters, woken only on purpose: changes of the lock word
+// alone wake nobody, and with nobody asleep a wakeup costs no syscall
+class WaitQueue {
 public:
-    void Read(auto func) {
-        atm_.fetch_add(1);
-        uint32_t old = atm_.load();
-        while (GetWriters(old) > 0) {
-            atm_.wait(old);
-            old = atm_.load();
+    // Sleeps while word holds old, until woken
+    template <class Word>
+    void Wait(const std::atomic<Word>& word, Word old) {
+        num_sleepers_.fetch_add(1);
+        auto seq = std::atomic_ref<int>(seq_).load();
+        // The waker changes word before it looks at num_sleepers_, so either it sees us,
+        // or we see the change
+        if (word.load() == old) {
+            FutexWait(&seq_, seq);
         }
+        num_sleepers_.fetch_sub(1, std::memory_order::relaxed);
+    }
+
+    void WakeOne() {
+        Wake(1);
+    }
+
+    void WakeAll() {
+        Wake(-1);
+    }
+
+private:
+    void Wake(int count) {
+        if (num_sleepers_.load() > 0) {
+            std::atomic_ref<int>(seq_).fetch_add(1);
+            FutexWake(&seq_, count);
+        }
+    }
+
+    int seq_{0};
+    std::atomic<int> num_sleepers_{0};
+};
+
+}  // namespace rw_lock_detail
+
+// Readers, writers, upgradable readers and an upgrading reader sleep on separate futex
+// words: a leaving writer wakes the batch of readers, and one writer once nobody is inside.
+// Word is the type of the state; 32 bits is enough for benchmarks against the 64-bit default
+template <class Policy, std::unsigned_integral Word = uint64_t>
+class BasicRWLock {
+    static_assert(std::numeric_limits<Word>::digits >= 32);
+
+public:
+    // Passed to the callback of ReadUpgradable
+    class UpgradeHandle {
+    public:
+        // Waits for the other readers to leave and makes the caller the writer;
+        // no writer can get in between
+        void Upgrade() {
+            if (!upgraded_) {
+                rw_lock_.StartUpgrade();
+                upgraded_ = true;
+            }
+        }
+
+        bool IsUpgraded() const {
+            return upgraded_;
+        }
+
+    private:
+        friend class BasicRWLock;
+
+        explicit UpgradeHandle(BasicRWLock& rw_lock) : rw_lock_{rw_lock} {
+        }
+
+        BasicRWLock& rw_lock_;
+        bool upgraded_ = false;
+    };
+
+    void Read(auto func) {
+        StartRead();
         try {
             func();
         } catch (...) {
@@ -21,33 +120,254 @@ public:
     }
 
     void Write(auto func) {
-        uint32_t zero = 0;
-        while (!atm_.compare_exchange_strong(zero, kOneWriter)) {
-            atm_.wait(zero);
-            zero = 0;
+        StartWrite();
+        try {
+            func();
+        } catch (...) {
+            EndWrite();
+            throw;
+        }
+        EndWrite();
+    }
+
+    // Reads alongside plain readers, and func(handle) may call handle.Upgrade() to write.
+    // Only one upgradable reader at a time, the others wait
+    void ReadUpgradable(auto func) {
+        StartReadUpgradable();
+        UpgradeHandle handle{*this};
+        try {
+            func(handle);
+        } catch (...) {
+            EndReadUpgradable(handle.upgraded_);
+            throw;
         }
-        func();
-        atm_.fetch_and((static_cast<uint32_t>(1) << 16) - 1);
-        atm_.notify_all();
+        EndReadUpgradable(handle.upgraded_);
     }
 
 private:
+    void StartRead() {
+        if constexpr (!Policy::kReadersYieldToPendingWriter) {
+            // Counted in even behind an active writer, so that the next writer waits for us.
+            // The check comes before the add: a full count must never carry into the next field
+            Word old = atm_.load();
+            do {
+                CheckOverflow(GetReaders(old), kMaxReaders);
+            } while (!atm_.compare_exchange_weak(old, old + kOneReader));
+            old += kOneReader;
+            while (old & kActiveWriter) {
+                readers_.Wait(atm_, old);
+                old = atm_.load();
+            }
+            return;
+        }
+        Word old = atm_.load();
+        while (true) {
+            if (!(old & (kActiveWriter | kPendingWriter | kUpgrading))) {
+                CheckOverflow(GetReaders(old), kMaxReaders);
+                if (atm_.compare_exchange_weak(old, old + kOneReader)) {
+                    return;
+                }
+            } else if constexpr (Policy::kAdmitWaitingReaders) {
+                // The writer that leaves next counts us in as an active reader
+                // and flips the phase
+                CheckOverflow(GetWaitingReaders(old), kMaxWaitingReaders);
+                if (atm_.compare_exchange_weak(old, old + kOneWaitingReader)) {
+                    auto phase = old & kPhase;
+                    old += kOneWaitingReader;
+                    while ((old & kPhase) == phase) {
+                        readers_.Wait(atm_, old);
+                        old = atm_.load();
+                    }
+                    return;
+                }
+            } else {
+                readers_.Wait(atm_, old);
+                old = atm_.load();
+            }
+        }
+    }
+
     void EndRead() {
-        if (atm_.fetch_sub(1) == 1) {
-            atm_.notify_all();
+        auto old = atm_.fetch_sub(kOneReader);
+        if (GetReaders(old) == 1) {
+            writers_.WakeOne();
+        } else if (GetReaders(old) == 2 && (old & kUpgrader)) {
+            // The upgradable reader may wait to be the last one
+            upgrade_.WakeOne();
         }
     }
 
-    uint32_t GetWriters(uint32_t value) {
-        return value >> 16;
+    void StartReadUpgradable() {
+        Word old = atm_.load();
+        while (true) {
+            auto blocked = kActiveWriter | kUpgrader;
+            if constexpr (Policy::kReadersYieldToPendingWriter) {
+                blocked |= kPendingWriter;
+            }
+            if (!(old & blocked)) {
+                CheckOverflow(GetReaders(old), kMaxReaders);
+                if (atm_.compare_exchange_weak(old, (old + kOneReader) | kUpgrader)) {
+                    return;
+                }
+            } else {
+                upgraders_.Wait(atm_, old);
+                old = atm_.load();
+            }
+        }
     }
 
-    uint32_t GetReaders(uint32_t value) {
-        return (value & ((static_cast<uint32_t>(1) << 16) - 1));
+    // Holding a read lock keeps writers out, so only the readers need to drain.
+    // New readers are kept out by a flag of our own: the pending-writer flag belongs
+    // to the writers with tickets, and one of them may be waiting for us to finish
+    void StartUpgrade() {
+        Word old = atm_.load();
+        if constexpr (Policy::kReadersYieldToPendingWriter) {
+            old = atm_.fetch_or(kUpgrading) | kUpgrading;
+        }
+        while (true) {
+            if (GetReaders(old) == 1) {
+                auto desired = ((old - kOneReader) & ~kUpgrading) | kActiveWriter;
+                if (atm_.compare_exchange_weak(old, desired)) {
+                    return;
+                }
+            } else {
+                upgrade_.Wait(atm_, old);
+                old = atm_.load();
+            }
+        }
+    }
+
+    void EndReadUpgradable(bool upgraded) {
+        if (upgraded) {
+            // A writer that raised the flag meanwhile still has it up
+            EndExclusive(/*writer_waits=*/false);
+        } else {
+            auto old = atm_.fetch_sub(kOneReader + kUpgrader);
+            upgraders_.WakeOne();
+            if (GetReaders(old) == 1) {
+                writers_.WakeOne();
+            }
+        }
+    }
+
+    void StartWrite() {
+        Word old = atm_.load();
+        if constexpr (Policy::kReadersYieldToPendingWriter) {
+            // Writers line up by ticket, and only the first of them raises the flag.
+            // A ticket holder sleeps with a bit of its own, so a handoff wakes only the next
+            auto ticket = static_cast<uint32_t>(std::atomic_ref<int>(next_writer_).fetch_add(1));
+            for (auto serving = ServingTicket(); serving != ticket; serving = ServingTicket()) {
+                FutexWaitBitset(&serving_writer_, static_cast<int>(serving), TicketBit(ticket));
+            }
+            old = atm_.fetch_or(kPendingWriter) | kPendingWriter;
+        }
+        while (true) {
+            if (GetReaders(old) == 0 && !(old & kActiveWriter)) {
+                if (atm_.compare_exchange_weak(old, (old & ~kPendingWriter) | kActiveWriter)) {
+                    return;
+                }
+            } else {
+                writers_.Wait(atm_, old);
+                old = atm_.load();
+            }
+        }
+    }
+
+    // Leaves the lock, then hands the ticket on. Only the ticket holder moves serving_writer_,
+    // so the ticket served next is known up front, and the flag is kept up for its holder
+    void EndWrite() {
+        if constexpr (Policy::kReadersYieldToPendingWriter) {
+            auto serving = ServingTicket() + 1;
+            EndExclusive(/*writer_waits=*/NextTicket() != serving);
+            std::atomic_ref<int>(serving_writer_).store(static_cast<int>(serving));
+            if (NextTicket() != serving) {
+                FutexWakeBitset(&serving_writer_, -1, TicketBit(serving));
+            }
+        } else {
+            EndExclusive(/*writer_waits=*/false);
+        }
+    }
+
+    void EndExclusive(bool writer_waits) {
+        Word old = atm_.load();
+        Word desired;
+        do {
+            desired = old & ~(kActiveWriter | kUpgrader);
+            if constexpr (Policy::kAdmitWaitingReaders) {
+                auto waiting = GetWaitingReaders(old);
+                desired = (desired - waiting * kOneWaitingReader + waiting * kOneReader) ^ kPhase;
+            }
+            // Keep new readers out until the next writer in line raises the flag itself
+            if (Policy::kReadersYieldToPendingWriter && writer_waits) {
+                desired |= kPendingWriter;
+            }
+        } while (!atm_.compare_exchange_weak(old, desired));
+        if (Policy::kAdmitWaitingReaders || !(desired & kPendingWriter)) {
+            readers_.WakeAll();
+        }
+        if (!(desired & kPendingWriter)) {
+            upgraders_.WakeOne();
+        }
+        if (GetReaders(desired) == 0) {
+            writers_.WakeOne();
+        }
+    }
+
+    // Tickets wrap around, so they are compared as unsigned
+    uint32_t NextTicket() {
+        return static_cast<uint32_t>(std::atomic_ref<int>(next_writer_).load());
+    }
+
+    uint32_t ServingTicket() {
+        return static_cast<uint32_t>(std::atomic_ref<int>(serving_writer_).load());
+    }
+
+    static uint32_t TicketBit(uint32_t ticket) {
+        return static_cast<uint32_t>(1) << (ticket % 32);
+    }
+
+    // A counter at its maximum must not spill into the next field
+    static void CheckOverflow(Word count, Word max) {
+        if (count == max) [[unlikely]] {
+            ThrowOverflow();
+        }
+    }
+
+    [[noreturn]] static void ThrowOverflow() {
+        throw std::overflow_error{"too many RWLock readers"};
+    }
+
+    static Word GetReaders(Word value) {
+        return value & kMaxReaders;
+    }
+
+    static Word GetWaitingReaders(Word value) {
+        return (value & (kUpgrader - 1)) / kOneWaitingReader;
     }
 
 private:
-    static const uint32_t kOneWriter = static_cast<uint32_t>(1) << 16;
+    // The low half holds active readers, the upgradable one included, then up to the top
+    // byte readers waiting to be let in by a leaving writer; the top byte holds an upgradable
+    // reader, the phase that waiting readers wait to change, a pending and an active writer,
+    // and an upgrading reader. For 64 bits: [0, 32), [32, 56) and bits 56-60
+    static constexpr int kBits = std::numeric_limits<Word>::digits;
+    static constexpr Word kOneReader = 1;
+    static constexpr Word kOneWaitingReader = Word{1} << (kBits / 2);
+    static constexpr Word kMaxReaders = kOneWaitingReader - 1;
+    static constexpr Word kUpgrader = Word{1} << (kBits - 8);
+    static constexpr Word kMaxWaitingReaders = (kUpgrader - 1) / kOneWaitingReader;
+    static constexpr Word kPhase = kUpgrader << 1;
+    static constexpr Word kPendingWriter = kUpgrader << 2;
+    static constexpr Word kActiveWriter = kUpgrader << 3;
+    static constexpr Word kUpgrading = kUpgrader << 4;
 
-    std::atomic<uint32_t> atm_{0};
+    std::atomic<Word> atm_{0};
+    rw_lock_detail::WaitQueue readers_;
+    rw_lock_detail::WaitQueue writers_;
+    rw_lock_detail::WaitQueue upgraders_;
+    rw_lock_detail::WaitQueue upgrade_;
+    int next_writer_{0};
+    int serving_writer_{0};
 };
+
+using RWLock = BasicRWLock<ReaderPreferring>;
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "../spinlock/spinlock.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Sequence lock for small trivially copyable values: a reader copies the value and
+// retries if the version changed meanwhile, so it never writes to shared memory.
+// The version is odd while a writer updates the value, writers are serialized by WriterLock.
+//
+// The value is kept in relaxed atomic words, so that the copy a reader makes while
+// a writer is storing is a torn but well-defined one, discarded by the version check.
+template <class T, class WriterLock = SpinLock>
+class SeqLock {
+    static_assert(std::is_trivially_copyable_v<T>);
+    static_assert(alignof(T) <= alignof(uint64_t));
+
+public:
+    SeqLock() : SeqLock(T{}) {
+    }
+
+    explicit SeqLock(const T& value) : value_{value} {
+        Store(value);
+    }
+
+    T Read() const {
+        while (true) {
+            auto version = version_.load(std::memory_order::acquire);
+            if (version & 1) {
+                CpuRelax();
+                continue;
+            }
+            auto value = Load();
+            std::atomic_thread_fence(std::memory_order::acquire);
+            if (version_.load(std::memory_order::relaxed) == version) {
+                return value;
+            }
+        }
+    }
+
+    // func gets the value by reference and changes it; readers see either the old value
+    // or the new one
+    void Write(auto func) {
+        writer_lock_.Lock();
+        auto value = value_;
+        try {
+            func(value);
+        } catch (...) {
+            writer_lock_.Unlock();
+            throw;
+        }
+        value_ = value;
+        auto version = version_.load(std::memory_order::relaxed);
+        version_.store(version + 1, std::memory_order::relaxed);
+        std::atomic_thread_fence(std::memory_order::release);
+        Store(value);
+        version_.store(version + 2, std::memory_order::release);
+        writer_lock_.Unlock();
+    }
+
+private:
+    static constexpr size_t kNumWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    T Load() const {
+        std::array<uint64_t, kNumWords> words;
+        for (size_t i = 0; i < kNumWords; ++i) {
+            words[i] = words_[i].load(std::memory_order::relaxed);
+        }
+        T value;
+        std::memcpy(&value, words.data(), sizeof(T));
+        return value;
+    }
+
+    void Store(const T& value) {
+        std::array<uint64_t, kNumWords> words{};
+        std::memcpy(words.data(), &value, sizeof(T));
+        for (size_t i = 0; i < kNumWords; ++i) {
+            words_[i].store(words[i], std::memory_order::relaxed);
+        }
+    }
+
+    std::atomic<uint64_t> version_{0};
+    std::array<std::atomic<uint64_t>, kNumWords> words_;
+    // The writers' copy of the value, under writer_lock_
+    T value_;
+    WriterLock writer_lock_;
+};
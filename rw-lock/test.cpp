@@ -1,11 +1,18 @@
 #include "rw_lock.h"
+#include "big_reader_lock.h"
+#include "seqlock.h"
+#include "rcu_cell.h"
+#include "../mutex/mutex.h"
 
 #include <thread>
 #include <vector>
 #include <atomic>
 #include <algorithm>
+#include <latch>
 #include <iostream>
+#include <memory>
 #include <numeric>
+#include <stdexcept>
 
 #include <catch2/catch_test_macros.hpp>
 
@@ -22,10 +29,11 @@ auto ElapsedTime(std::chrono::steady_clock::time_point start) {
 
 }  // namespace
 
-TEST_CASE("Increment") {
+template <class Lock>
+void TestIncrement() {
     static constexpr auto kTimeLimit = 1s;
     static constexpr auto kNumThreadsInGroup = 8;
-    RWLock rw_lock;
+    Lock rw_lock;
     std::vector<int> r_counters(kNumThreadsInGroup);
     std::vector<int> w_counters(kNumThreadsInGroup);
 
@@ -62,10 +70,11 @@ TEST_CASE("Increment") {
     std::cout << "read count " << read_count << ", write count " << write_count << "\n";
 }
 
-TEST_CASE("RLock") {
+template <class Lock>
+void TestRLock() {
     static constexpr auto kTimeLimit = .5s;
     static constexpr auto kReadFunc = [] { std::this_thread::sleep_for(kTimeLimit); };
-    RWLock rw_lock;
+    Lock rw_lock;
     std::vector<std::jthread> threads;
 
     auto start = kNow();
@@ -77,9 +86,10 @@ TEST_CASE("RLock") {
     REQUIRE(ElapsedTime(start) < 2 * kTimeLimit);
 }
 
-TEST_CASE("OnlyWritingOrReading") {
+template <class Lock>
+void TestOnlyWritingOrReading() {
     static constexpr auto kTimeLimit = 1s;
-    RWLock rw_lock;
+    Lock rw_lock;
     std::atomic_flag is_writing;
     std::atomic num_reading = 0;
     std::atomic result = 0;
@@ -112,3 +122,369 @@ TEST_CASE("OnlyWritingOrReading") {
     threads.clear();
     REQUIRE(result == 0);
 }
+
+TEST_CASE("Increment") {
+    TestIncrement<RWLock>();
+}
+
+TEST_CASE("RLock") {
+    TestRLock<RWLock>();
+}
+
+TEST_CASE("OnlyWritingOrReading") {
+    TestOnlyWritingOrReading<RWLock>();
+}
+
+TEST_CASE("BigReaderLock") {
+    TestIncrement<BigReaderLock>();
+    TestRLock<BigReaderLock>();
+    TestOnlyWritingOrReading<BigReaderLock>();
+}
+
+// Readers overlap so that there is always one inside, the writer must still get in
+template <class Lock>
+void TestWriterNotStarved() {
+    static constexpr auto kNumReaders = 8;
+    Lock rw_lock;
+    std::atomic<bool> stop = false;
+    std::vector<std::jthread> threads;
+    for (auto i = 0; i < kNumReaders; ++i) {
+        threads.emplace_back([&] {
+            while (!stop) {
+                rw_lock.Read([] { std::this_thread::sleep_for(1ms); });
+            }
+        });
+    }
+    std::this_thread::sleep_for(50ms);
+
+    auto start = kNow();
+    for (auto i = 0; i < 10; ++i) {
+        rw_lock.Write([] {});
+    }
+    auto elapsed = ElapsedTime(start);
+    stop = true;
+    threads.clear();
+    REQUIRE(elapsed < 1s);
+}
+
+// Writers that never stop keep readers out, so no TestIncrement
+TEST_CASE("WriterPreferring") {
+    TestRLock<BasicRWLock<WriterPreferring>>();
+    TestOnlyWritingOrReading<BasicRWLock<WriterPreferring>>();
+    TestWriterNotStarved<BasicRWLock<WriterPreferring>>();
+}
+
+TEST_CASE("PhaseFair") {
+    TestIncrement<BasicRWLock<PhaseFair>>();
+    TestRLock<BasicRWLock<PhaseFair>>();
+    TestOnlyWritingOrReading<BasicRWLock<PhaseFair>>();
+    TestWriterNotStarved<BasicRWLock<PhaseFair>>();
+}
+
+// A throwing writer must leave the lock free, for readers and writers alike
+template <class Lock>
+void TestWriteThrows() {
+    Lock rw_lock;
+    auto value = 0;
+    REQUIRE_THROWS_AS(rw_lock.Write([&] {
+        ++value;
+        throw std::runtime_error{"no"};
+    }), std::runtime_error);
+    auto seen = 0;
+    std::jthread{[&] { rw_lock.Read([&] { seen = value; }); }}.join();
+    REQUIRE(seen == 1);
+    rw_lock.Write([&] { ++value; });
+    REQUIRE(value == 2);
+}
+
+// Holds depth read locks at once while func runs
+template <class Lock>
+void NestReads(Lock& rw_lock, int depth, auto func) {
+    if (depth == 0) {
+        func();
+        return;
+    }
+    rw_lock.Read([&] { NestReads(rw_lock, depth - 1, func); });
+}
+
+// The threads fill the reader count of a 32-bit word, then one reader more must throw
+// and leave the lock as it was
+template <class Lock>
+void TestReadOverflow() {
+    static constexpr auto kNumThreads = 64;
+    static constexpr auto kMaxReaders = (1 << 16) - 1;
+    Lock rw_lock;
+    std::latch all_in{kNumThreads};
+    std::atomic<bool> release = false;
+    std::vector<std::jthread> threads;
+    for (auto i = 0; i < kNumThreads; ++i) {
+        auto depth = kMaxReaders / kNumThreads + (i < kMaxReaders % kNumThreads);
+        threads.emplace_back([&, depth] {
+            NestReads(rw_lock, depth, [&] {
+                all_in.count_down();
+                release.wait(false);
+            });
+        });
+    }
+    all_in.wait();
+    REQUIRE_THROWS_AS(rw_lock.Read([] {}), std::overflow_error);
+    REQUIRE_THROWS_AS(rw_lock.ReadUpgradable([](auto&) {}), std::overflow_error);
+    release = true;
+    release.notify_all();
+    threads.clear();
+    auto value = 0;
+    rw_lock.Write([&] { ++value; });
+    rw_lock.Read([&] { ++value; });
+    REQUIRE(value == 2);
+}
+
+TEST_CASE("ReadOverflow") {
+    TestReadOverflow<BasicRWLock<ReaderPreferring, uint32_t>>();
+    TestReadOverflow<BasicRWLock<WriterPreferring, uint32_t>>();
+    TestReadOverflow<BasicRWLock<PhaseFair, uint32_t>>();
+}
+
+TEST_CASE("WriteThrows") {
+    TestWriteThrows<BasicRWLock<ReaderPreferring>>();
+    TestWriteThrows<BasicRWLock<WriterPreferring>>();
+    TestWriteThrows<BasicRWLock<PhaseFair>>();
+}
+
+// A plain Read on a lock nobody else wants. If it is not in within a second, a Write lets
+// it through, so that a stale pending-writer flag fails the test instead of hanging it
+template <class Lock>
+bool ReadGetsIn(Lock& rw_lock) {
+    std::atomic done = false;
+    std::jthread reader{[&] {
+        rw_lock.Read([] {});
+        done = true;
+    }};
+    auto start = kNow();
+    while (!done && ElapsedTime(start) < 1s) {
+        std::this_thread::sleep_for(1ms);
+    }
+    auto got_in = done.load();
+    if (!got_in) {
+        rw_lock.Write([] {});
+    }
+    return got_in;
+}
+
+// What an upgradable reader saw must still hold after Upgrade(), with writers and other
+// upgradable readers around
+template <class Lock>
+void TestUpgrade() {
+    static constexpr auto kTimeLimit = 1s;
+    Lock rw_lock;
+    auto value = 0;
+    std::atomic num_changed = 0;
+    std::atomic num_updates = 0;
+    std::atomic num_upgrades = 0;
+    std::vector<std::jthread> threads;
+    for (auto i = 0; i < 4; ++i) {
+        threads.emplace_back([&] {
+            auto start = kNow();
+            for (auto j = 0; ElapsedTime(start) < kTimeLimit; ++j) {
+                rw_lock.ReadUpgradable([&](auto& handle) {
+                    auto seen = std::atomic_ref{value}.load();
+                    if (j % 2) {
+                        return;
+                    }
+                    handle.Upgrade();
+                    if (value != seen) {
+                        ++num_changed;
+                    }
+                    ++value;
+                    ++num_upgrades;
+                });
+            }
+        });
+        threads.emplace_back([&] {
+            auto start = kNow();
+            while (ElapsedTime(start) < kTimeLimit) {
+                rw_lock.Write([&] { ++value; });
+                ++num_updates;
+                std::this_thread::sleep_for(100us);
+            }
+        });
+        threads.emplace_back([&] {
+            auto start = kNow();
+            while (ElapsedTime(start) < kTimeLimit) {
+                rw_lock.Read([&] { static_cast<void>(std::atomic_ref{value}.load()); });
+            }
+        });
+    }
+    threads.clear();
+
+    REQUIRE(ReadGetsIn(rw_lock));
+    REQUIRE(num_changed == 0);
+    REQUIRE(num_upgrades > 100);
+    REQUIRE(value == num_updates + num_upgrades);
+
+    rw_lock.ReadUpgradable([](auto& handle) { REQUIRE(!handle.IsUpgraded()); });
+    REQUIRE_THROWS_AS(rw_lock.ReadUpgradable([](auto& handle) {
+        handle.Upgrade();
+        throw std::runtime_error{"no"};
+    }), std::runtime_error);
+    rw_lock.Write([&] { ++value; });
+}
+
+// An upgrader that gets in and out while a writer is leaving must not leave a pending-writer
+// flag behind once there are no writers. Every other round has two writers, so that one
+// hands its ticket to the other around the upgrader
+template <class Lock>
+void TestUpgradeAfterWrite() {
+    static constexpr auto kRounds = 200;
+    Lock rw_lock;
+    auto value = 0;
+    auto num_writes = 0;
+    for (auto i = 0; i < kRounds; ++i) {
+        {
+            std::vector<std::jthread> writers;
+            for (auto j = 0; j <= i % 2; ++j) {
+                writers.emplace_back([&] { rw_lock.Write([&] { ++value; }); });
+                ++num_writes;
+            }
+            std::jthread upgrader{[&] {
+                rw_lock.ReadUpgradable([&](auto& handle) {
+                    handle.Upgrade();
+                    ++value;
+                });
+            }};
+        }
+        REQUIRE(ReadGetsIn(rw_lock));
+    }
+    REQUIRE(value == num_writes + kRounds);
+}
+
+TEST_CASE("Upgrade") {
+    TestUpgrade<BasicRWLock<ReaderPreferring>>();
+    TestUpgrade<BasicRWLock<WriterPreferring>>();
+    TestUpgrade<BasicRWLock<PhaseFair>>();
+    // The 32-bit word the benchmarks compare against has every flag at another bit
+    TestUpgrade<BasicRWLock<PhaseFair, uint32_t>>();
+    TestUpgradeAfterWrite<BasicRWLock<ReaderPreferring>>();
+    TestUpgradeAfterWrite<BasicRWLock<WriterPreferring>>();
+    TestUpgradeAfterWrite<BasicRWLock<PhaseFair>>();
+}
+
+// Writers keep the fields equal, a reader must never see them differ
+template <class WriterLock>
+void TestSeqLock() {
+    static constexpr auto kTimeLimit = 1s;
+    struct Value {
+        uint64_t a;
+        uint32_t b;
+        uint16_t c;
+    };
+    SeqLock<Value, WriterLock> seq_lock{Value{1, 1, 1}};
+    std::atomic num_torn = 0;
+    std::atomic num_reads = 0;
+    std::atomic num_writes = 0;
+    std::vector<std::jthread> threads;
+    for (auto i = 0; i < 4; ++i) {
+        threads.emplace_back([&] {
+            auto start = kNow();
+            while (ElapsedTime(start) < kTimeLimit) {
+                seq_lock.Write([](Value& value) {
+                    ++value.a;
+                    value.b = static_cast<uint32_t>(value.a);
+                    value.c = static_cast<uint16_t>(value.a);
+                });
+                ++num_writes;
+            }
+        });
+        threads.emplace_back([&] {
+            auto start = kNow();
+            while (ElapsedTime(start) < kTimeLimit) {
+                auto value = seq_lock.Read();
+                if (static_cast<uint32_t>(value.a) != value.b ||
+                    static_cast<uint16_t>(value.a) != value.c) {
+                    ++num_torn;
+                }
+                ++num_reads;
+            }
+        });
+    }
+    threads.clear();
+
+    REQUIRE(num_torn == 0);
+    REQUIRE(num_reads > 1'000);
+    REQUIRE(seq_lock.Read().a == static_cast<uint64_t>(num_writes) + 1);
+}
+
+TEST_CASE("SeqLock") {
+    TestSeqLock<SpinLock>();
+    TestSeqLock<Mutex>();
+
+    SeqLock<int> seq_lock{1};
+    REQUIRE_THROWS_AS(seq_lock.Write([](int& value) {
+        value = 2;
+        throw std::runtime_error{"no"};
+    }), std::runtime_error);
+    REQUIRE(seq_lock.Read() == 1);
+    seq_lock.Write([](int& value) { value = 3; });
+    REQUIRE(seq_lock.Read() == 3);
+}
+
+TEST_CASE("RcuCell") {
+    static constexpr auto kTimeLimit = 1s;
+    static constexpr auto kMaxVersions = 100'000;
+    // A version is marked when its value gets deleted, readers must never see a marked one
+    static std::vector<std::atomic<bool>> deleted(kMaxVersions);
+    struct Value {
+        ~Value() {
+            deleted[version].store(true);
+        }
+
+        int version;
+        int copy;
+    };
+
+    RcuCell<Value> cell{std::make_unique<Value>(0, 0)};
+    std::atomic num_bad = 0;
+    std::atomic num_reads = 0;
+    auto num_updates = 0;
+    {
+        std::vector<std::jthread> threads;
+        for (auto i = 0; i < 8; ++i) {
+            threads.emplace_back([&] {
+                auto start = kNow();
+                while (ElapsedTime(start) < kTimeLimit) {
+                    cell.Read([&](const Value& value) {
+                        if (value.version != value.copy || deleted[value.version]) {
+                            ++num_bad;
+                        }
+                        // Give the writer a chance to delete it under our feet
+                        std::this_thread::yield();
+                        if (deleted[value.version]) {
+                            ++num_bad;
+                        }
+                    });
+                    ++num_reads;
+                }
+            });
+        }
+        threads.emplace_back([&] {
+            auto start = kNow();
+            while (ElapsedTime(start) < kTimeLimit && num_updates + 2 < kMaxVersions) {
+                ++num_updates;
+                if (num_updates % 2) {
+                    cell.Store(std::make_unique<Value>(num_updates, num_updates));
+                } else {
+                    cell.Update([&](Value& value) {
+                        value.version = num_updates;
+                        value.copy = num_updates;
+                    });
+                }
+            }
+        });
+    }
+
+    REQUIRE(num_bad == 0);
+    REQUIRE(num_reads > 1'000);
+    REQUIRE(num_updates > 10);
+    REQUIRE(cell.Read([](const Value& value) { return value.version; }) == num_updates);
+    REQUIRE(std::all_of(deleted.begin(), deleted.begin() + num_updates,
+                        [](const auto& flag) { return flag.load(); }));
+}
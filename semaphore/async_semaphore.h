@@ -0,0 +1,178 @@
+#pragma once
+
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+
+// Runs resumed coroutines: Schedule(handle) must call handle.resume() at some point
+template <class E>
+concept Executor = requires(E& executor, std::coroutine_handle<> handle) {
+    { executor.Schedule(handle) } -> std::same_as<void>;
+};
+
+// Resumes coroutines right on the thread that schedules them. A coroutine scheduled while
+// another one runs under this executor on the same thread waits until that one suspends
+// or ends, so a chain of handoffs does not grow the stack.
+class InlineExecutor {
+public:
+    void Schedule(std::coroutine_handle<> handle) {
+        static thread_local std::deque<std::coroutine_handle<>> pending;
+        static thread_local bool running = false;
+        pending.push_back(handle);
+        if (running) {
+            return;
+        }
+        running = true;
+        struct StopRunning {
+            ~StopRunning() {
+                running = false;
+            }
+        } stop_running;
+        while (!pending.empty()) {
+            auto next = pending.front();
+            pending.pop_front();
+            next.resume();
+        }
+    }
+};
+
+// Queues scheduled coroutines until RunAll resumes them, like the run loop of a thread
+class RunLoopExecutor {
+public:
+    void Schedule(std::coroutine_handle<> handle) {
+        pending_.push_back(handle);
+    }
+
+    // Also runs the coroutines scheduled meanwhile
+    void RunAll() {
+        while (!pending_.empty()) {
+            auto handle = pending_.front();
+            pending_.pop_front();
+            handle.resume();
+        }
+    }
+
+    size_t NumPending() const {
+        return pending_.size();
+    }
+
+private:
+    std::deque<std::coroutine_handle<>> pending_;
+};
+
+// Coroutine that starts at once and frees its frame when it ends
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() {
+            return {};
+        }
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+        void return_void() {
+        }
+        void unhandled_exception() {
+            std::terminate();
+        }
+    };
+};
+
+// Semaphore for coroutines: co_await AcquireAsync() suspends the coroutine until it gets
+// a permit instead of blocking the thread. Waiters queue up in their awaiters, which live
+// in the coroutine frames, and Release hands the permit to the first one and schedules it
+// on the executor it came with, after the mutex is released. A permit handed over is never
+// counted as free, so newcomers cannot take it and the order is FIFO.
+class AsyncSemaphore {
+public:
+    class Awaiter {
+    public:
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        // Returns false, which resumes the coroutine at once, if a permit is free
+        bool await_suspend(std::coroutine_handle<> handle) {
+            std::lock_guard lock{semaphore_.mutex_};
+            if (semaphore_.count_ > 0) {
+                --semaphore_.count_;
+                return false;
+            }
+            handle_ = handle;
+            (semaphore_.tail_ ? semaphore_.tail_->next_ : semaphore_.head_) = this;
+            semaphore_.tail_ = this;
+            return true;
+        }
+
+        void await_resume() const noexcept {
+        }
+
+    private:
+        friend class AsyncSemaphore;
+
+        using Schedule = void (*)(void* executor, std::coroutine_handle<> handle);
+
+        Awaiter(AsyncSemaphore& semaphore, void* executor, Schedule schedule)
+            : semaphore_{semaphore}, executor_{executor}, schedule_{schedule} {
+        }
+
+        AsyncSemaphore& semaphore_;
+        void* executor_;
+        Schedule schedule_;
+        std::coroutine_handle<> handle_;
+        Awaiter* next_ = nullptr;
+    };
+
+    explicit AsyncSemaphore(int count) : count_{count} {
+    }
+
+    // The coroutine is resumed by executor, which must outlive the wait
+    template <Executor E>
+    Awaiter AcquireAsync(E& executor) {
+        return {*this, &executor, [](void* executor, std::coroutine_handle<> handle) {
+                    static_cast<E*>(executor)->Schedule(handle);
+                }};
+    }
+
+    // The coroutine is resumed inside Release
+    Awaiter AcquireAsync() {
+        static InlineExecutor executor;
+        return AcquireAsync(executor);
+    }
+
+    bool TryAcquire() {
+        std::lock_guard lock{mutex_};
+        if (count_ == 0) {
+            return false;
+        }
+        --count_;
+        return true;
+    }
+
+    void Release() {
+        std::unique_lock lock{mutex_};
+        auto* waiter = head_;
+        if (!waiter) {
+            ++count_;
+            return;
+        }
+        head_ = waiter->next_;
+        if (!head_) {
+            tail_ = nullptr;
+        }
+        lock.unlock();
+        // The frame holding the waiter may be gone once the coroutine is resumed
+        waiter->schedule_(waiter->executor_, waiter->handle_);
+    }
+
+private:
+    int count_;
+    Awaiter* head_ = nullptr;
+    Awaiter* tail_ = nullptr;
+    std::mutex mutex_;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "../mutex/mutex.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+// Fair semaphore without a mutex: Acquire takes a ticket and owns a permit once
+// the number of grants (initial count plus releases) passes the ticket.
+// Uncontended Acquire and Release are a single atomic add each; a thread sleeps only
+// when permits run out, on a futex bit of its own ticket, so Release wakes exactly it.
+//
+// Tickets and grants are 32-bit and wrap around, they are compared by their difference.
+class FastSemaphore {
+public:
+    explicit FastSemaphore(int count) : grants_{count} {
+    }
+
+    // Like Semaphore::Acquire, callbacks run one at a time and in ticket order.
+    // count is the number of permits left, ours included. Unlike Semaphore::Acquire(callback),
+    // the callback cannot choose how many permits to take: the ticket has already taken one,
+    // and count is a copy, changing it has no effect
+    void Acquire(auto callback) {
+        // A callback ticket comes with the same add as the permit ticket, so the two orders agree
+        auto tickets = next_.fetch_add(kOneTicket | kOneCallbackTicket);
+        auto ticket = static_cast<uint32_t>(tickets);
+        auto callback_ticket = static_cast<uint32_t>(tickets >> 32);
+        WaitForGrant(ticket);
+
+        auto done_atm = std::atomic_ref<int>(callbacks_done_);
+        for (auto done = static_cast<uint32_t>(done_atm.load(std::memory_order::acquire));
+             done != callback_ticket;
+             done = static_cast<uint32_t>(done_atm.load(std::memory_order::acquire))) {
+            FutexWaitBitset(&callbacks_done_, static_cast<int>(done), TicketBit(callback_ticket));
+        }
+        // Permits nobody has taken a ticket for, plus ours. Grants are loaded first: both only
+        // grow, and we hold a ticket, so this stays within the capacity
+        auto grants = static_cast<uint32_t>(
+            std::atomic_ref<int>(grants_).load(std::memory_order::acquire));
+        auto free = static_cast<int32_t>(grants - static_cast<uint32_t>(next_.load()));
+        auto count = std::max(free, 0) + 1;
+        callback(count);
+        done_atm.store(static_cast<int>(callback_ticket + 1), std::memory_order::release);
+        if (static_cast<uint32_t>(next_.load() >> 32) != callback_ticket + 1) {
+            FutexWakeBitset(&callbacks_done_, -1, TicketBit(callback_ticket + 1));
+        }
+    }
+
+    void Acquire() {
+        WaitForGrant(static_cast<uint32_t>(next_.fetch_add(kOneTicket)));
+    }
+
+    void Release() {
+        auto granted = static_cast<uint32_t>(std::atomic_ref<int>(grants_).fetch_add(1));
+        // The holder of the ticket just granted may be asleep
+        if (Before(granted, static_cast<uint32_t>(next_.load()))) {
+            FutexWakeBitset(&grants_, -1, TicketBit(granted));
+        }
+    }
+
+private:
+    // Low half: next ticket, high half: next callback ticket
+    static constexpr uint64_t kOneTicket = 1;
+    static constexpr uint64_t kOneCallbackTicket = uint64_t{1} << 32;
+
+    static bool Before(uint32_t a, uint32_t b) {
+        return static_cast<int32_t>(a - b) < 0;
+    }
+
+    static uint32_t TicketBit(uint32_t ticket) {
+        return uint32_t{1} << (ticket % 32);
+    }
+
+    void WaitForGrant(uint32_t ticket) {
+        auto grants_atm = std::atomic_ref<int>(grants_);
+        auto grants = static_cast<uint32_t>(grants_atm.load(std::memory_order::acquire));
+        while (!Before(ticket, grants)) {
+            FutexWaitBitset(&grants_, static_cast<int>(grants), TicketBit(ticket));
+            grants = static_cast<uint32_t>(grants_atm.load(std::memory_order::acquire));
+        }
+    }
+
+    std::atomic<uint64_t> next_{0};
+    int grants_;
+    int callbacks_done_{0};
+};
@@ -0,0 +1,164 @@
+#include "semaphore.h"
+#include "fast_semaphore.h"
+#include "async_semaphore.h"
+#include "runner.h"
+#include "../lock-bench/matrix.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace std::chrono_literals;
+
+// Acquire and Release by num_threads threads sharing concurrency_level permits
+template <class SemaphoreType>
+static void RunAcquireRelease(const std::string& name, int concurrency_level,
+                              uint32_t num_threads) {
+    SemaphoreType semaphore{concurrency_level};
+    TimeRunner runner{500ms};
+    for (auto i = 0u; i < num_threads; ++i) {
+        runner.Do([&] {
+            semaphore.Acquire();
+            semaphore.Release();
+        });
+    }
+    auto time_per_op = runner.Wait();
+    std::cout << name << " " << concurrency_level << " permits, " << num_threads
+              << " threads: " << time_per_op.count() << "ns per Acquire + Release" << std::endl;
+}
+
+TEST_CASE("Benchmark") {
+    for (auto num_threads : {1u, 2u, 4u, 8u}) {
+        for (auto concurrency_level : {1, 4, 64}) {
+            RunAcquireRelease<Semaphore>("Semaphore", concurrency_level, num_threads);
+            RunAcquireRelease<FastSemaphore>("FastSemaphore", concurrency_level, num_threads);
+        }
+    }
+}
+
+// Voluntary context switches of the whole process so far: a thread that wakes up and finds
+// it is not its turn goes back to sleep, which counts as one more
+static uint64_t VoluntaryContextSwitches() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<uint64_t>(usage.ru_nvcsw);
+}
+
+// num_waiters threads queue up on an empty semaphore, then permits are released one by one,
+// each acquirer passing its permit on
+template <class SemaphoreType>
+static void RunWakeups(const std::string& name, uint32_t num_waiters) {
+    static constexpr auto kRounds = 20;
+    SemaphoreType semaphore{0};
+    std::vector<std::jthread> threads;
+    for (auto i = 0u; i < num_waiters; ++i) {
+        threads.emplace_back([&] {
+            for (auto j = 0; j < kRounds; ++j) {
+                semaphore.Acquire();
+                semaphore.Release();
+            }
+        });
+    }
+    std::this_thread::sleep_for(100ms);
+    auto start = VoluntaryContextSwitches();
+    semaphore.Release();
+    threads.clear();
+    auto switches = VoluntaryContextSwitches() - start;
+    std::cout << name << " " << num_waiters << " waiters: "
+              << static_cast<double>(switches) / (kRounds * num_waiters)
+              << " context switches per release" << std::endl;
+}
+
+TEST_CASE("Wakeups") {
+    RunWakeups<Semaphore>("Semaphore", 64);
+    RunWakeups<FastSemaphore>("FastSemaphore", 64);
+}
+
+// Threads wanting 1, 2, 4 and all 8 permits at a time share 8 permits: the time a request
+// waits should grow with its weight, without the large ones being starved
+static void RunMixedWeights() {
+    static constexpr auto kCapacity = 8;
+    static constexpr auto kTimeLimit = 500ms;
+    static constexpr int kWeights[] = {1, 1, 2, 2, 4, 4, 8, 8};
+    Semaphore semaphore{kCapacity};
+    std::vector<LatencyHistogram> latencies(std::size(kWeights));
+    {
+        std::vector<std::jthread> threads;
+        for (size_t i = 0; i < std::size(kWeights); ++i) {
+            threads.emplace_back([&, i] {
+                auto weight = kWeights[i];
+                auto start = std::chrono::steady_clock::now();
+                for (auto now = start; now - start < kTimeLimit;) {
+                    semaphore.Acquire(weight);
+                    auto wait_time = std::chrono::steady_clock::now() - now;
+                    latencies[i].Record(static_cast<uint64_t>(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(wait_time).count()));
+                    semaphore.Release(weight);
+                    now = std::chrono::steady_clock::now();
+                }
+            });
+        }
+    }
+    for (auto weight : {1, 2, 4, 8}) {
+        LatencyHistogram total;
+        for (size_t i = 0; i < std::size(kWeights); ++i) {
+            if (kWeights[i] == weight) {
+                total.Merge(latencies[i]);
+            }
+        }
+        std::cout << "Semaphore weight " << weight << ": " << total.Count()
+                  << " acquires, wait p50 " << total.Percentile(0.5) << "ns, p99 "
+                  << total.Percentile(0.99) << "ns, max " << total.Percentile(1) << "ns"
+                  << std::endl;
+    }
+}
+
+TEST_CASE("MixedWeights") {
+    RunMixedWeights();
+}
+
+// num_waiters coroutines suspend on an empty semaphore, then a single permit goes down
+// the whole queue, each waiter passing it on
+template <class ExecutorType>
+static void RunCoroutineWaiters(const std::string& name, uint32_t num_waiters) {
+    AsyncSemaphore semaphore{0};
+    ExecutorType executor;
+    uint32_t num_done = 0;
+    auto waiter = [&]() -> Detached {
+        co_await semaphore.AcquireAsync(executor);
+        ++num_done;
+        semaphore.Release();
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto i = 0u; i < num_waiters; ++i) {
+        waiter();
+    }
+    auto suspended = std::chrono::steady_clock::now();
+    semaphore.Release();
+    if constexpr (requires { executor.RunAll(); }) {
+        executor.RunAll();
+    }
+    auto done = std::chrono::steady_clock::now();
+    REQUIRE(num_done == num_waiters);
+
+    auto per_waiter = [num_waiters](auto duration) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() /
+               num_waiters;
+    };
+    std::cout << "AsyncSemaphore, " << name << ", " << num_waiters << " waiters: "
+              << per_waiter(suspended - start) << "ns per suspend, "
+              << per_waiter(done - suspended) << "ns per handoff" << std::endl;
+}
+
+TEST_CASE("CoroutineWaiters") {
+    RunCoroutineWaiters<InlineExecutor>("inline", 100'000);
+    RunCoroutineWaiters<RunLoopExecutor>("run loop", 100'000);
+}
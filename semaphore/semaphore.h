@@ -1,42 +1,185 @@
 #pragma once
 
+#include <chrono>
+#include <concepts>
 #include <mutex>
 #include <condition_variable>
+#include <stdexcept>
+#include <stop_token>
 
+// Waiters queue up in nodes on their own stacks. Release hands permits to the waiters
+// without them, in order, and wakes only those; waiters holding permits leave the queue
+// in order, so callbacks run in ticket order. A waiter for n permits blocks the ones
+// behind it until it gets all n at once, so large requests are not starved by small ones.
+// A waiter that times out or is cancelled unlinks its node, passing on what it was granted.
 class Semaphore {
 public:
     explicit Semaphore(int count) : count_{count} {
     }
 
-    void Acquire(auto callback) {
-        std::unique_lock lock{mutex_};
-        auto thread_ticket = ticket_++;
-        cv_.wait(lock, [this, thread_ticket] {
-            if (count_ && (thread_ticket <= top_)) {
-                return true;
-            } else if (count_) {
-                cv_.notify_one();
-            }
+    // Waits for n permits, then calls callback(count), which is to take them from count
+    void Acquire(int n, auto callback) {
+        Waiter waiter{.weight = n};
+        AcquireOrGiveUp(waiter, callback, [this, &waiter](std::unique_lock<std::mutex>& lock) {
+            waiter.cv.wait(lock, [this, &waiter] { return IsReady(waiter); });
+            return true;
+        });
+    }
+
+    void Acquire(std::invocable<int&> auto callback) {
+        Acquire(1, callback);
+    }
+
+    void Acquire(int n = 1) {
+        Acquire(n, Take{n});
+    }
+
+    // Fails if there are fewer than n permits or somebody is waiting
+    bool TryAcquire(int n = 1) {
+        CheckWeight(n);
+        std::lock_guard lock{mutex_};
+        if (head_ || count_ < n) {
             return false;
+        }
+        count_ -= n;
+        return true;
+    }
+
+    // Acquire(n) that gives up at deadline, returns whether it got the permits
+    template <class Clock, class Duration>
+    bool TryAcquireUntil(const std::chrono::time_point<Clock, Duration>& deadline, int n = 1) {
+        Waiter waiter{.weight = n};
+        return AcquireOrGiveUp(waiter, Take{n}, [&](std::unique_lock<std::mutex>& lock) {
+            return waiter.cv.wait_until(lock, deadline, [this, &waiter] {
+                return IsReady(waiter);
+            });
         });
-        callback(count_);
-        ++top_;
     }
 
-    void Acquire() {
-        Acquire([](int& value) { --value; });
+    template <class Rep, class Period>
+    bool TryAcquireFor(const std::chrono::duration<Rep, Period>& timeout, int n = 1) {
+        return TryAcquireUntil(std::chrono::steady_clock::now() + timeout, n);
     }
 
-    void Release() {
+    // Acquire(n) that gives up once stop is requested on token
+    bool Acquire(std::stop_token token, int n = 1) {
+        Waiter waiter{.weight = n};
+        // Runs right here if stop is already requested, so the mutex must not be held yet
+        std::stop_callback wake_up{token, [this, &waiter] {
+            std::lock_guard lock{mutex_};
+            waiter.cv.notify_one();
+        }};
+        return AcquireOrGiveUp(waiter, Take{n}, [&](std::unique_lock<std::mutex>& lock) {
+            waiter.cv.wait(lock, [&] { return IsReady(waiter) || token.stop_requested(); });
+            return IsReady(waiter);
+        });
+    }
+
+    void Release(int n = 1) {
+        CheckWeight(n);
         std::lock_guard lock{mutex_};
-        ++count_;
-        cv_.notify_one();
+        count_ += n;
+        GrantAvailable();
     }
 
 private:
+    struct Waiter {
+        int weight;
+        std::condition_variable cv;
+        bool granted = false;
+        Waiter* prev = nullptr;
+        Waiter* next = nullptr;
+    };
+
+    // The callback of plain Acquire
+    struct Take {
+        void operator()(int& value) const {
+            value -= n;
+        }
+        int n;
+    };
+
+    static void CheckWeight(int n) {
+        if (n < 0) {
+            throw std::invalid_argument{"negative number of permits"};
+        }
+    }
+
+    bool IsReady(const Waiter& waiter) const {
+        return waiter.granted && head_ == &waiter;
+    }
+
+    // wait(lock) blocks until the waiter is ready or gives up, and returns whether it is ready
+    bool AcquireOrGiveUp(Waiter& waiter, auto callback, auto wait) {
+        CheckWeight(waiter.weight);
+        std::unique_lock lock{mutex_};
+        if (!head_ && count_ >= waiter.weight) {
+            callback(count_);
+            return true;
+        }
+
+        Enqueue(&waiter);
+        // Permits not handed out yet may be enough for the newcomer
+        GrantAvailable();
+        if (!wait(lock)) {
+            Remove(&waiter);
+            return false;
+        }
+        num_granted_ -= waiter.weight;
+        callback(count_);
+        Dequeue();
+        if (head_ && head_->granted) {
+            head_->cv.notify_one();
+        }
+        return true;
+    }
+
+    void Enqueue(Waiter* waiter) {
+        waiter->prev = tail_;
+        (tail_ ? tail_->next : head_) = waiter;
+        tail_ = waiter;
+        if (!next_to_grant_) {
+            next_to_grant_ = waiter;
+        }
+    }
+
+    void Dequeue() {
+        head_ = head_->next;
+        (head_ ? head_->prev : tail_) = nullptr;
+    }
+
+    // Takes out a waiter that gave up. It is never a granted head, so nobody behind it was
+    // granted unless it was too; permits granted to it go back, and the ones it held up move on
+    void Remove(Waiter* waiter) {
+        (waiter->prev ? waiter->prev->next : head_) = waiter->next;
+        (waiter->next ? waiter->next->prev : tail_) = waiter->prev;
+        if (next_to_grant_ == waiter) {
+            next_to_grant_ = waiter->next;
+        }
+        if (waiter->granted) {
+            num_granted_ -= waiter->weight;
+        }
+        GrantAvailable();
+    }
+
+    // A granted waiter that is not at the head is woken later by the one in front of it
+    void GrantAvailable() {
+        while (next_to_grant_ && count_ - num_granted_ >= next_to_grant_->weight) {
+            auto* waiter = next_to_grant_;
+            next_to_grant_ = waiter->next;
+            waiter->granted = true;
+            num_granted_ += waiter->weight;
+            if (waiter == head_) {
+                waiter->cv.notify_one();
+            }
+        }
+    }
+
     int count_;
-    int64_t ticket_{0};
-    int64_t top_{0};
+    // Permits handed to waiters that have not used them yet, all at the front of the queue
+    int num_granted_{0};
+    Waiter* head_ = nullptr;
+    Waiter* tail_ = nullptr;
+    Waiter* next_to_grant_ = nullptr;
     std::mutex mutex_;
-    std::condition_variable cv_;
 };
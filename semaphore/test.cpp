@@ -1,18 +1,23 @@
 #include "semaphore.h"
+#include "fast_semaphore.h"
+#include "async_semaphore.h"
 
 #include <thread>
 #include <vector>
 #include <atomic>
 #include <ranges>
 #include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <stop_token>
 
 #include <catch2/catch_test_macros.hpp>
 
 using namespace std::chrono_literals;
 
-template <int concurrency_level>
+template <class SemaphoreType, int concurrency_level>
 void RunTest(int threads_count) {
-    Semaphore semaphore{concurrency_level};
+    SemaphoreType semaphore{concurrency_level};
     auto time = 0;
     for (auto i : std::views::iota(0, concurrency_level)) {
         semaphore.Acquire([&time, i](int& count) {
@@ -44,8 +49,9 @@ void RunTest(int threads_count) {
     REQUIRE(time == threads_count);
 }
 
-static void TestOrder() {
-    Semaphore semaphore{1};
+template <class SemaphoreType>
+void TestOrder() {
+    SemaphoreType semaphore{1};
     auto time = 0;
     std::vector<std::jthread> threads;
     std::atomic_flag flag;
@@ -86,19 +92,285 @@ static void TestOrder() {
 }
 
 TEST_CASE("Mutex") {
-    std::ranges::for_each(std::views::iota(0, 15), RunTest<1>);
+    std::ranges::for_each(std::views::iota(0, 15), RunTest<Semaphore, 1>);
 }
 
 TEST_CASE("Semaphore_3") {
-    std::ranges::for_each(std::views::iota(0, 15), RunTest<3>);
+    std::ranges::for_each(std::views::iota(0, 15), RunTest<Semaphore, 3>);
 }
 
 TEST_CASE("Semaphore_5") {
-    std::ranges::for_each(std::views::iota(0, 15), RunTest<5>);
+    std::ranges::for_each(std::views::iota(0, 15), RunTest<Semaphore, 5>);
 }
 
 TEST_CASE("Order") {
     for (auto i = 0; i < 5; ++i) {
-        TestOrder();
+        TestOrder<Semaphore>();
+    }
+}
+
+TEST_CASE("FastSemaphore") {
+    std::ranges::for_each(std::views::iota(0, 15), RunTest<FastSemaphore, 1>);
+    std::ranges::for_each(std::views::iota(0, 15), RunTest<FastSemaphore, 3>);
+    std::ranges::for_each(std::views::iota(0, 15), RunTest<FastSemaphore, 5>);
+    for (auto i = 0; i < 5; ++i) {
+        TestOrder<FastSemaphore>();
+    }
+}
+
+// Plain and callback Acquire mixed: never more than concurrency_level holders at once
+template <class SemaphoreType>
+void TestConcurrencyLimit() {
+    static constexpr auto kConcurrencyLevel = 3;
+    static constexpr auto kNumThreads = 8;
+    static constexpr auto kNumIterations = 10'000;
+    SemaphoreType semaphore{kConcurrencyLevel};
+    std::atomic num_holders = 0;
+    std::atomic num_errors = 0;
+    std::vector<std::jthread> threads;
+    for (auto i = 0; i < kNumThreads; ++i) {
+        threads.emplace_back([&, i] {
+            for (auto j = 0; j < kNumIterations; ++j) {
+                if ((i + j) % 2) {
+                    semaphore.Acquire();
+                } else {
+                    semaphore.Acquire([&](int& count) {
+                        num_errors += count <= 0 || count > kConcurrencyLevel;
+                        --count;
+                    });
+                }
+                num_errors += ++num_holders > kConcurrencyLevel;
+                --num_holders;
+                semaphore.Release();
+            }
+        });
+    }
+    threads.clear();
+    REQUIRE(num_errors == 0);
+}
+
+TEST_CASE("ConcurrencyLimit") {
+    TestConcurrencyLimit<Semaphore>();
+    TestConcurrencyLimit<FastSemaphore>();
+}
+
+TEST_CASE("TryAcquire") {
+    Semaphore semaphore{3};
+    REQUIRE(semaphore.TryAcquire(2));
+    REQUIRE(!semaphore.TryAcquire(2));
+    REQUIRE(semaphore.TryAcquire());
+    REQUIRE(!semaphore.TryAcquire());
+    semaphore.Release(3);
+    REQUIRE_THROWS_AS(semaphore.TryAcquire(-1), std::invalid_argument);
+
+    // A waiter for 4 is in the queue, so nobody may take the 3 permits past it
+    std::jthread waiter{[&] {
+        semaphore.Acquire(4);
+        semaphore.Release(4);
+    }};
+    std::this_thread::sleep_for(20ms);
+    REQUIRE(!semaphore.TryAcquire());
+    semaphore.Release();
+    waiter.join();
+    REQUIRE(semaphore.TryAcquire(4));
+}
+
+// The permits held at once never exceed the capacity, and requests for all of them
+// get through between the small ones
+TEST_CASE("Weighted") {
+    static constexpr auto kCapacity = 10;
+    static constexpr auto kTimeLimit = 500ms;
+    Semaphore semaphore{kCapacity};
+    std::atomic in_flight = 0;
+    std::atomic num_errors = 0;
+    std::atomic num_full = 0;
+    std::vector<std::jthread> threads;
+    for (auto i = 0; i < 8; ++i) {
+        threads.emplace_back([&, i] {
+            auto weight = i == 0 ? kCapacity : i;
+            auto start = std::chrono::steady_clock::now();
+            while (std::chrono::steady_clock::now() - start < kTimeLimit) {
+                semaphore.Acquire(weight);
+                num_errors += (in_flight += weight) > kCapacity;
+                num_full += weight == kCapacity;
+                std::this_thread::yield();
+                in_flight -= weight;
+                semaphore.Release(weight);
+            }
+        });
+    }
+    threads.clear();
+    REQUIRE(num_errors == 0);
+    REQUIRE(num_full > 10);
+}
+
+TEST_CASE("TryAcquireFor") {
+    Semaphore semaphore{1};
+    REQUIRE(semaphore.TryAcquireFor(10ms));
+    auto start = std::chrono::steady_clock::now();
+    REQUIRE(!semaphore.TryAcquireFor(20ms));
+    REQUIRE(std::chrono::steady_clock::now() - start >= 20ms);
+
+    // A waiter for 2 holds up a waiter for 1 until it times out
+    std::jthread big{[&] { REQUIRE(!semaphore.TryAcquireFor(100ms, 2)); }};
+    std::this_thread::sleep_for(20ms);
+    std::atomic small_done = false;
+    std::jthread small{[&] {
+        semaphore.Acquire();
+        small_done = true;
+    }};
+    semaphore.Release();
+    std::this_thread::sleep_for(20ms);
+    REQUIRE(!small_done);
+    small.join();
+    big.join();
+    REQUIRE(small_done);
+}
+
+TEST_CASE("Cancel") {
+    Semaphore semaphore{1};
+    std::stop_source stopped;
+    stopped.request_stop();
+    REQUIRE(semaphore.Acquire(stopped.get_token()));
+    REQUIRE(!semaphore.Acquire(stopped.get_token()));
+
+    // The cancelled waiter is at the head, the granted one behind it goes ahead
+    std::jthread big{[&](std::stop_token token) { REQUIRE(!semaphore.Acquire(token, 2)); }};
+    std::this_thread::sleep_for(20ms);
+    std::jthread small{[&] { semaphore.Acquire(); }};
+    semaphore.Release();
+    std::this_thread::sleep_for(20ms);
+    big.request_stop();
+    small.join();
+    big.join();
+    REQUIRE(!semaphore.TryAcquire());
+    semaphore.Release();
+    REQUIRE(semaphore.TryAcquire());
+}
+
+// Waiters giving up all the time must neither leak nor double count permits
+TEST_CASE("GiveUpStress") {
+    static constexpr auto kCapacity = 4;
+    static constexpr auto kTimeLimit = 500ms;
+    Semaphore semaphore{kCapacity};
+    std::atomic in_flight = 0;
+    std::atomic num_errors = 0;
+    std::atomic num_timeouts = 0;
+    std::atomic num_cancelled = 0;
+    std::vector<std::jthread> threads;
+    for (auto i = 0; i < 8; ++i) {
+        threads.emplace_back([&, i] {
+            auto weight = i % kCapacity + 1;
+            auto start = std::chrono::steady_clock::now();
+            for (auto j = 0; std::chrono::steady_clock::now() - start < kTimeLimit; ++j) {
+                auto acquired = true;
+                if (i % 3 == 0) {
+                    semaphore.Acquire(weight);
+                } else if (i % 3 == 1) {
+                    acquired = semaphore.TryAcquireFor(std::chrono::microseconds{j % 50}, weight);
+                    num_timeouts += !acquired;
+                } else {
+                    std::stop_source source;
+                    if (j % 2) {
+                        source.request_stop();
+                    }
+                    acquired = semaphore.Acquire(source.get_token(), weight);
+                    num_cancelled += !acquired;
+                }
+                if (!acquired) {
+                    continue;
+                }
+                num_errors += (in_flight += weight) > kCapacity;
+                std::this_thread::yield();
+                in_flight -= weight;
+                semaphore.Release(weight);
+            }
+        });
+    }
+    threads.clear();
+    REQUIRE(num_errors == 0);
+    REQUIRE(num_timeouts > 0);
+    REQUIRE(num_cancelled > 0);
+    REQUIRE(semaphore.TryAcquire(kCapacity));
+    REQUIRE(!semaphore.TryAcquire());
+}
+
+TEST_CASE("AsyncSemaphore") {
+    static constexpr auto kNumWaiters = 10;
+    AsyncSemaphore semaphore{1};
+    std::vector<int> order;
+    auto waiter = [&](int i) -> Detached {
+        co_await semaphore.AcquireAsync();
+        order.push_back(i);
+        semaphore.Release();
+    };
+
+    REQUIRE(semaphore.TryAcquire());
+    for (auto i = 0; i < kNumWaiters; ++i) {
+        waiter(i);
+    }
+    REQUIRE(order.empty());
+    // Each waiter passes the permit on, the chain runs inside this Release
+    semaphore.Release();
+    REQUIRE(std::ranges::equal(order, std::views::iota(0, kNumWaiters)));
+    REQUIRE(semaphore.TryAcquire());
+    REQUIRE(!semaphore.TryAcquire());
+}
+
+TEST_CASE("AsyncSemaphoreExecutor") {
+    AsyncSemaphore semaphore{0};
+    RunLoopExecutor executor;
+    auto num_done = 0;
+    auto waiter = [&]() -> Detached {
+        co_await semaphore.AcquireAsync(executor);
+        ++num_done;
+        semaphore.Release();
+    };
+
+    for (auto i = 0; i < 3; ++i) {
+        waiter();
+    }
+    semaphore.Release();
+    REQUIRE(num_done == 0);
+    REQUIRE(executor.NumPending() == 1);
+    executor.RunAll();
+    REQUIRE(num_done == 3);
+    REQUIRE(semaphore.TryAcquire());
+}
+
+// Coroutines started on several threads and resumed by whichever thread releases
+TEST_CASE("AsyncSemaphoreConcurrencyLimit") {
+    static constexpr auto kConcurrencyLevel = 3;
+    static constexpr auto kNumThreads = 4;
+    static constexpr auto kNumCoroutines = 100;
+    static constexpr auto kNumIterations = 100;
+    AsyncSemaphore semaphore{kConcurrencyLevel};
+    std::atomic num_holders = 0;
+    std::atomic num_errors = 0;
+    std::atomic num_done = 0;
+    auto worker = [&]() -> Detached {
+        for (auto i = 0; i < kNumIterations; ++i) {
+            co_await semaphore.AcquireAsync();
+            num_errors += ++num_holders > kConcurrencyLevel;
+            --num_holders;
+            ++num_done;
+            semaphore.Release();
+        }
+    };
+
+    std::vector<std::jthread> threads;
+    for (auto i = 0; i < kNumThreads; ++i) {
+        threads.emplace_back([&] {
+            for (auto j = 0; j < kNumCoroutines; ++j) {
+                worker();
+            }
+        });
+    }
+    threads.clear();
+    REQUIRE(num_errors == 0);
+    REQUIRE(num_done == kNumThreads * kNumCoroutines * kNumIterations);
+    for (auto i = 0; i < kConcurrencyLevel; ++i) {
+        REQUIRE(semaphore.TryAcquire());
     }
+    REQUIRE(!semaphore.TryAcquire());
 }
@@ -0,0 +1,183 @@
+#pragma once
+
+#include "spinlock.h"
+#include "../mutex/mutex.h"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sched.h>
+
+// Mapping from CPUs to NUMA nodes
+class NumaTopology {
+public:
+    using CurrentCpuFunc = size_t (*)();
+
+    // current_cpu lets tests pretend that a thread runs on a given CPU
+    explicit NumaTopology(std::vector<size_t> node_of_cpu, CurrentCpuFunc current_cpu = SchedGetCpu)
+        : node_of_cpu_{std::move(node_of_cpu)}, current_cpu_{current_cpu} {
+        if (node_of_cpu_.empty()) {
+            node_of_cpu_.push_back(0);
+        }
+        for (auto node : node_of_cpu_) {
+            num_nodes_ = std::max(num_nodes_, node + 1);
+        }
+    }
+
+    // Reads /sys/devices/system/node; everything is node 0 if it is not available
+    static NumaTopology Detect() {
+        std::vector<size_t> node_of_cpu(std::max(1u, std::thread::hardware_concurrency()), 0);
+        std::error_code error;
+        for (const auto& entry :
+             std::filesystem::directory_iterator{"/sys/devices/system/node", error}) {
+            auto name = entry.path().filename().string();
+            if (name.size() <= 4 || name.compare(0, 4, "node") != 0 ||
+                name.find_first_not_of("0123456789", 4) != std::string::npos) {
+                continue;
+            }
+            auto node = std::stoul(name.substr(4));
+            std::ifstream cpulist{entry.path() / "cpulist"};
+            std::string ranges;
+            std::getline(cpulist, ranges);
+            for (auto cpu : ParseCpuList(ranges)) {
+                if (cpu >= node_of_cpu.size()) {
+                    node_of_cpu.resize(cpu + 1, 0);
+                }
+                node_of_cpu[cpu] = node;
+            }
+        }
+        return NumaTopology{std::move(node_of_cpu)};
+    }
+
+    // Splits num_cpus CPUs into num_nodes nodes of consecutive CPUs
+    static NumaTopology Simulate(size_t num_nodes,
+                                 size_t num_cpus = std::thread::hardware_concurrency(),
+                                 CurrentCpuFunc current_cpu = SchedGetCpu) {
+        num_cpus = std::max(num_cpus, num_nodes);
+        std::vector<size_t> node_of_cpu(num_cpus);
+        for (size_t cpu = 0; cpu < num_cpus; ++cpu) {
+            node_of_cpu[cpu] = cpu * num_nodes / num_cpus;
+        }
+        return NumaTopology{std::move(node_of_cpu), current_cpu};
+    }
+
+    size_t NumNodes() const {
+        return num_nodes_;
+    }
+
+    size_t NumCpus() const {
+        return node_of_cpu_.size();
+    }
+
+    size_t NodeOfCpu(size_t cpu) const {
+        return node_of_cpu_[cpu % node_of_cpu_.size()];
+    }
+
+    size_t CurrentNode() const {
+        return NodeOfCpu(current_cpu_());
+    }
+
+    std::vector<size_t> CpusOfNode(size_t node) const {
+        std::vector<size_t> cpus;
+        for (size_t cpu = 0; cpu < node_of_cpu_.size(); ++cpu) {
+            if (node_of_cpu_[cpu] == node) {
+                cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }
+
+    // "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}
+    static std::vector<size_t> ParseCpuList(const std::string& ranges) {
+        std::vector<size_t> cpus;
+        std::stringstream stream{ranges};
+        std::string range;
+        while (std::getline(stream, range, ',')) {
+            if (range.empty()) {
+                continue;
+            }
+            auto dash = range.find('-');
+            auto first = std::stoul(range.substr(0, dash));
+            auto last = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+            for (auto cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }
+
+private:
+    static size_t SchedGetCpu() {
+        auto cpu = sched_getcpu();
+        return cpu < 0 ? 0 : static_cast<size_t>(cpu);
+    }
+
+    std::vector<size_t> node_of_cpu_;
+    size_t num_nodes_ = 0;
+    CurrentCpuFunc current_cpu_;
+};
+
+// Lock cohorting (Dice, Marathe, Shavit): threads first take the SpinLock of their
+// NUMA node, and only the first of them takes the global Mutex. While other threads
+// of the same node are waiting, the global lock is passed along inside the node,
+// at most max_local_handoffs times in a row, so it rarely crosses the interconnect.
+class CohortLock {
+public:
+    static constexpr uint32_t kDefaultMaxLocalHandoffs = 64;
+
+    explicit CohortLock(NumaTopology topology = NumaTopology::Detect(),
+                        uint32_t max_local_handoffs = kDefaultMaxLocalHandoffs)
+        : topology_{std::move(topology)},
+          max_local_handoffs_{max_local_handoffs},
+          nodes_{std::make_unique<Node[]>(topology_.NumNodes())} {
+    }
+
+    void Lock() {
+        auto node_index = topology_.CurrentNode();
+        auto& node = nodes_[node_index];
+        node.num_waiting.fetch_add(1, std::memory_order_relaxed);
+        node.local.Lock();
+        node.num_waiting.fetch_sub(1, std::memory_order_relaxed);
+        if (!node.owns_global) {
+            global_.Lock();
+            node.owns_global = true;
+            node.num_handoffs = 0;
+        }
+        owner_node_ = node_index;
+    }
+
+    void Unlock() {
+        auto& node = nodes_[owner_node_];
+        if (node.num_waiting.load(std::memory_order_relaxed) > 0 &&
+            ++node.num_handoffs < max_local_handoffs_) {
+            node.local.Unlock();
+            return;
+        }
+        node.owns_global = false;
+        global_.Unlock();
+        node.local.Unlock();
+    }
+
+private:
+    struct alignas(64) Node {
+        SpinLock local;
+        std::atomic<uint32_t> num_waiting{0};
+        // Protected by local
+        bool owns_global = false;
+        uint32_t num_handoffs = 0;
+    };
+
+    const NumaTopology topology_;
+    const uint32_t max_local_handoffs_;
+    std::unique_ptr<Node[]> nodes_;
+    alignas(64) Mutex global_;
+    // Written only by the current owner
+    size_t owner_node_ = 0;
+};
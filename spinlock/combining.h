@@ -0,0 +1,126 @@
+#pragma once
+
+#include "spinlock.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <type_traits>
+
+// Flat combining on top of a lock with TryLock()/Unlock().
+// A thread that cannot take the lock publishes its operation in a slot and spins
+// on that slot; whoever holds the lock runs all published operations in one batch,
+// so the protected data stays in the combiner's cache.
+template <class Lock>
+class Combining {
+public:
+    static constexpr size_t kNumSlots = 64;
+
+    template <class Func>
+    void Execute(Func&& op) {
+        if (lock_.TryLock()) {
+            RunAndCombine(op);
+            return;
+        }
+        auto* slot = ClaimSlot();
+        if (!slot) {
+            // More concurrent callers than slots
+            lock_.Lock();
+            RunAndCombine(op);
+            return;
+        }
+        slot->invoke = &Invoke<std::remove_reference_t<Func>>;
+        slot->arg = std::addressof(op);
+        slot->state.store(kPending, std::memory_order_release);
+
+        size_t num_polls = 0;
+        while (slot->state.load(std::memory_order_acquire) != kDone) {
+            if (++num_polls % kLockPollPeriod == 0 && lock_.TryLock()) {
+                Combine();
+                lock_.Unlock();
+            } else if (num_polls < kMaxSpins) {
+                CpuRelax();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+
+        auto error = std::move(slot->error);
+        slot->error = nullptr;
+        slot->state.store(kFree, std::memory_order_release);
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    static constexpr size_t kLockPollPeriod = 16;
+    static constexpr size_t kMaxSpins = 1'024;
+
+    enum State : uint32_t { kFree, kClaimed, kPending, kDone };
+
+    struct alignas(64) Slot {
+        std::atomic<uint32_t> state{kFree};
+        void (*invoke)(void*) = nullptr;
+        void* arg = nullptr;
+        std::exception_ptr error;
+    };
+
+    template <class Func>
+    static void Invoke(void* arg) {
+        (*static_cast<Func*>(arg))();
+    }
+
+    // A thread starts probing from its own slot, so in the common case it keeps
+    // writing to the same cache line
+    Slot* ClaimSlot() {
+        static std::atomic<size_t> next_index{0};
+        static thread_local size_t index = next_index.fetch_add(1) % kNumSlots;
+        for (size_t i = 0; i < kNumSlots; ++i) {
+            auto& slot = slots_[(index + i) % kNumSlots];
+            uint32_t expected = kFree;
+            if (slot.state.load(std::memory_order_relaxed) == kFree &&
+                slot.state.compare_exchange_strong(expected, kClaimed,
+                                                   std::memory_order_acquire,
+                                                   std::memory_order_relaxed)) {
+                return &slot;
+            }
+        }
+        return nullptr;
+    }
+
+    template <class Func>
+    void RunAndCombine(Func& op) {
+        try {
+            op();
+        } catch (...) {
+            Combine();
+            lock_.Unlock();
+            throw;
+        }
+        Combine();
+        lock_.Unlock();
+    }
+
+    // Called with the lock held
+    void Combine() {
+        for (size_t i = 0; i < kNumSlots; ++i) {
+            auto& slot = slots_[i];
+            if (slot.state.load(std::memory_order_acquire) != kPending) {
+                continue;
+            }
+            try {
+                slot.invoke(slot.arg);
+            } catch (...) {
+                slot.error = std::current_exception();
+            }
+            slot.state.store(kDone, std::memory_order_release);
+        }
+    }
+
+    alignas(64) Lock lock_;
+    std::array<Slot, kNumSlots> slots_;
+};
@@ -0,0 +1,193 @@
+#pragma once
+
+#include "spinlock.h"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Queue locks: every waiter spins on its own cache line and the lock is handed
+// over in FIFO order. After kMaxSpins unsuccessful polls a waiter starts yielding,
+// so the locks stay usable when there are more threads than cores.
+
+namespace queue_lock_detail {
+
+inline constexpr size_t kMaxSpins = 128;
+
+class SpinWait {
+public:
+    void Wait() {
+        if (num_spins_ < kMaxSpins) {
+            ++num_spins_;
+            CpuRelax();
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    size_t num_spins_ = 0;
+};
+
+// Per-thread cache of queue nodes, so Lock() does not allocate in the steady state.
+// Nodes are not tied to a lock instance: CLH passes them from thread to thread.
+template <class Node>
+class NodePool {
+public:
+    static Node* Acquire() {
+        auto& nodes = Instance().nodes_;
+        if (nodes.empty()) {
+            return new Node{};
+        }
+        auto* node = nodes.back();
+        nodes.pop_back();
+        return node;
+    }
+
+    static void Release(Node* node) {
+        Instance().nodes_.push_back(node);
+    }
+
+    ~NodePool() {
+        for (auto* node : nodes_) {
+            delete node;
+        }
+    }
+
+private:
+    static NodePool& Instance() {
+        static thread_local NodePool pool;
+        return pool;
+    }
+
+    std::vector<Node*> nodes_;
+};
+
+}  // namespace queue_lock_detail
+
+class TicketLock {
+public:
+    void Lock() {
+        auto ticket = next_ticket_.fetch_add(1, std::memory_order_relaxed);
+        queue_lock_detail::SpinWait spin_wait;
+        while (true) {
+            auto serving = now_serving_.load(std::memory_order_acquire);
+            if (serving == ticket) {
+                return;
+            }
+            // Proportional backoff: the farther we are from the head of the queue,
+            // the less often we touch the shared now_serving_ line
+            for (auto i = serving + 1; i != ticket; ++i) {
+                CpuRelax();
+            }
+            spin_wait.Wait();
+        }
+    }
+
+    void Unlock() {
+        now_serving_.store(now_serving_.load(std::memory_order_relaxed) + 1,
+                           std::memory_order_release);
+    }
+
+private:
+    alignas(64) std::atomic<uint32_t> next_ticket_{0};
+    alignas(64) std::atomic<uint32_t> now_serving_{0};
+};
+
+// Mellor-Crummey and Scott lock: a waiter spins on the flag in its own node
+// until the predecessor hands the lock over
+class MCSLock {
+private:
+    struct alignas(64) Node {
+        std::atomic<Node*> next{nullptr};
+        std::atomic<bool> locked{false};
+    };
+    using Pool = queue_lock_detail::NodePool<Node>;
+
+public:
+    void Lock() {
+        auto* node = Pool::Acquire();
+        node->next.store(nullptr, std::memory_order_relaxed);
+        node->locked.store(true, std::memory_order_relaxed);
+        auto* prev = tail_.exchange(node, std::memory_order_acq_rel);
+        if (prev) {
+            prev->next.store(node, std::memory_order_release);
+            queue_lock_detail::SpinWait spin_wait;
+            while (node->locked.load(std::memory_order_acquire)) {
+                spin_wait.Wait();
+            }
+        }
+        holder_ = node;
+    }
+
+    void Unlock() {
+        auto* node = holder_;
+        auto* next = node->next.load(std::memory_order_acquire);
+        if (!next) {
+            auto* expected = node;
+            if (tail_.compare_exchange_strong(expected, nullptr, std::memory_order_release,
+                                              std::memory_order_relaxed)) {
+                Pool::Release(node);
+                return;
+            }
+            // Somebody has swapped the tail but has not linked itself yet
+            queue_lock_detail::SpinWait spin_wait;
+            while (!(next = node->next.load(std::memory_order_acquire))) {
+                spin_wait.Wait();
+            }
+        }
+        next->locked.store(false, std::memory_order_release);
+        Pool::Release(node);
+    }
+
+private:
+    alignas(64) std::atomic<Node*> tail_{nullptr};
+    // Written only by the current owner
+    alignas(64) Node* holder_ = nullptr;
+};
+
+// Craig, Landin and Hagersten lock: a waiter spins on the flag in its
+// predecessor's node and adopts that node after the lock is released
+class CLHLock {
+private:
+    struct alignas(64) Node {
+        std::atomic<bool> locked{false};
+    };
+    using Pool = queue_lock_detail::NodePool<Node>;
+
+public:
+    CLHLock() : tail_{new Node{}} {
+    }
+
+    CLHLock(const CLHLock&) = delete;
+    CLHLock& operator=(const CLHLock&) = delete;
+
+    ~CLHLock() {
+        delete tail_.load(std::memory_order_relaxed);
+    }
+
+    void Lock() {
+        auto* node = Pool::Acquire();
+        node->locked.store(true, std::memory_order_relaxed);
+        auto* prev = tail_.exchange(node, std::memory_order_acq_rel);
+        queue_lock_detail::SpinWait spin_wait;
+        while (prev->locked.load(std::memory_order_acquire)) {
+            spin_wait.Wait();
+        }
+        holder_ = node;
+        holder_prev_ = prev;
+    }
+
+    void Unlock() {
+        auto* prev = holder_prev_;
+        holder_->locked.store(false, std::memory_order_release);
+        Pool::Release(prev);
+    }
+
+private:
+    alignas(64) std::atomic<Node*> tail_;
+    // Written only by the current owner
+    alignas(64) Node* holder_ = nullptr;
+    Node* holder_prev_ = nullptr;
+};
@@ -1,11 +1,17 @@
 #include "spinlock.h"
+#include "queue_lock.h"
+#include "combining.h"
+#include "cohort_lock.h"
+#include "../deque/deque.h"
 #include "runner.h"
 #include "util.h"
 
 #include <string>
 #include <chrono>
 #include <thread>
-#include <string>
+#include <iostream>
+
+#include <pthread.h>
 
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/generators/catch_generators.hpp>
@@ -15,11 +21,12 @@ static constexpr auto kNow = std::chrono::steady_clock::now;
 
 using namespace std::chrono_literals;
 
-static void RunBenchmark(uint32_t num_threads) {
+template <class Lock>
+static void RunBenchmark(const std::string& name, uint32_t num_threads) {
     static constexpr auto kNumIterations = 1'000'000;
-    SpinLock lock;
+    Lock lock;
     int counter{};
-    BENCHMARK(std::to_string(num_threads)) {
+    BENCHMARK(name + " " + std::to_string(num_threads)) {
         counter = 0;
         Runner runner{kNumIterations};
         for (auto i = 0u; i < num_threads; ++i) {
@@ -35,7 +42,126 @@ static void RunBenchmark(uint32_t num_threads) {
 
 TEST_CASE("Benchmark") {
     for (auto num_threads : {1, 2, 4, 8, 16, 32}) {
-        RunBenchmark(num_threads);
+        RunBenchmark<BasicSpinLock<PauseWait>>("SpinLock<PauseWait>", num_threads);
+        RunBenchmark<BasicSpinLock<BackoffWait>>("SpinLock<BackoffWait>", num_threads);
+        RunBenchmark<BasicSpinLock<YieldWait>>("SpinLock<YieldWait>", num_threads);
+        RunBenchmark<BasicSpinLock<ParkWait>>("SpinLock<ParkWait>", num_threads);
+        RunBenchmark<TicketLock>("TicketLock", num_threads);
+        RunBenchmark<MCSLock>("MCSLock", num_threads);
+        RunBenchmark<CLHLock>("CLHLock", num_threads);
+    }
+}
+
+template <class WaitPolicy>
+static void PrintStats(const std::string& name, uint32_t num_threads) {
+    static constexpr auto kNumIterations = 1'000'000;
+    BasicSpinLock<WaitPolicy, /*kCollectStats=*/true> lock;
+    int counter{};
+    Runner runner{kNumIterations};
+    for (auto i = 0u; i < num_threads; ++i) {
+        runner.Do([&] {
+            lock.Lock();
+            ++counter;
+            lock.Unlock();
+        });
+    }
+    runner.Wait();
+    REQUIRE(counter == kNumIterations);
+    std::cout << name << " " << num_threads << ": " << lock.GetStats() << "\n";
+}
+
+TEST_CASE("Stats") {
+    for (auto num_threads : {1, 4, 16}) {
+        PrintStats<YieldWait>("SpinLock<YieldWait>", num_threads);
+        PrintStats<ParkWait>("SpinLock<ParkWait>", num_threads);
+    }
+}
+
+template <class Op>
+static void RunCombiningBenchmark(const std::string& name, uint32_t num_threads, Op op) {
+    static constexpr auto kNumIterations = 1'000'000;
+    SpinLock lock;
+    Combining<SpinLock> combining;
+    BENCHMARK(name + " Lock " + std::to_string(num_threads)) {
+        Runner runner{kNumIterations};
+        for (auto i = 0u; i < num_threads; ++i) {
+            runner.Do([&] {
+                lock.Lock();
+                op();
+                lock.Unlock();
+            });
+        }
+    };
+    BENCHMARK(name + " Combining " + std::to_string(num_threads)) {
+        Runner runner{kNumIterations};
+        for (auto i = 0u; i < num_threads; ++i) {
+            runner.Do([&] { combining.Execute(op); });
+        }
+    };
+}
+
+TEST_CASE("Combining") {
+    for (auto num_threads : {1, 2, 4, 8, 16, 32}) {
+        int64_t counter{};
+        RunCombiningBenchmark("Counter", num_threads, [&counter] { ++counter; });
+
+        Deque deque;
+        RunCombiningBenchmark("Deque", num_threads, [&deque] {
+            deque.PushBack(1);
+            if (deque.Size() > 64) {
+                deque.PopFront();
+            }
+        });
+    }
+}
+
+static void PinToCpu(size_t cpu) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+}
+
+// Thread i is pinned to node i % num_nodes, so every lock is contended across nodes
+template <class Lock>
+static void RunPinnedBenchmark(const std::string& name, const NumaTopology& topology,
+                               uint32_t num_threads, Lock& lock) {
+    static constexpr auto kNumIterations = 1'000'000;
+    int counter{};
+    BENCHMARK(name + " " + std::to_string(num_threads)) {
+        counter = 0;
+        Runner runner{kNumIterations};
+        for (auto i = 0u; i < num_threads; ++i) {
+            auto node = i % topology.NumNodes();
+            auto node_cpus = topology.CpusOfNode(node);
+            auto cpu = node_cpus[(i / topology.NumNodes()) % node_cpus.size()];
+            runner.Do([&, cpu, pinned = false]() mutable {
+                if (!pinned) {
+                    PinToCpu(cpu);
+                    pinned = true;
+                }
+                lock.Lock();
+                ++counter;
+                lock.Unlock();
+            });
+        }
+    };
+    REQUIRE(counter == kNumIterations);
+}
+
+TEST_CASE("Cohort") {
+    auto topology = NumaTopology::Detect();
+    if (topology.NumNodes() == 1) {
+        // Single node machine: still exercise the cohort code path
+        topology = NumaTopology::Simulate(2);
+    }
+    for (auto num_threads : {2, 4, 8, 16, 32}) {
+        SpinLock spin;
+        RunPinnedBenchmark("SpinLock", topology, num_threads, spin);
+        Mutex mutex;
+        RunPinnedBenchmark("Mutex", topology, num_threads, mutex);
+        CohortLock cohort{topology};
+        RunPinnedBenchmark("CohortLock", topology, num_threads, cohort);
     }
 }
 
@@ -1,27 +1,301 @@
 #pragma once
 
+#include "../mutex/mutex.h"
+
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
 #include <thread>
 
-class SpinLock {
+// Wait strategies for BasicSpinLock.
+// Wait(num_tries) is called on every failed poll of a busy lock and reports what it did;
+// kPark asks the lock to put the thread to sleep on the futex.
+// OnAcquired(num_tries, parked) is called by the new owner after a contended acquisition.
+
+enum class WaitResult { kSpun, kYielded, kPark };
+
+// Busy-wait with a PAUSE hint, for dedicated cores
+struct PauseWait {
+    static constexpr bool kParks = false;
+
+    WaitResult Wait(size_t /*num_tries*/) {
+        CpuRelax();
+        return WaitResult::kSpun;
+    }
+
+    void OnAcquired(size_t /*num_tries*/, bool /*parked*/) {
+    }
+};
+
+// Bounded exponential backoff with jitter, so waiters do not retry in lockstep
+struct BackoffWait {
+    static constexpr bool kParks = false;
+    static constexpr size_t kMaxShift = 10;
+
+    WaitResult Wait(size_t num_tries) {
+        auto limit = size_t{1} << std::min(num_tries, kMaxShift);
+        auto delay = limit / 2 + NextRandom() % (limit / 2 + 1);
+        for (size_t i = 0; i < delay; ++i) {
+            CpuRelax();
+        }
+        return WaitResult::kSpun;
+    }
+
+    void OnAcquired(size_t /*num_tries*/, bool /*parked*/) {
+    }
+
+private:
+    static uint32_t NextRandom() {
+        static thread_local uint32_t state =
+            static_cast<uint32_t>(std::hash<std::thread::id>{}(std::this_thread::get_id())) | 1;
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+};
+
+// Give up the time slice every kMaxNumTries polls
+struct YieldWait {
+    static constexpr bool kParks = false;
+    static constexpr size_t kMaxNumTries = 10;
+
+    WaitResult Wait(size_t num_tries) {
+        if ((num_tries + 1) % kMaxNumTries == 0) {
+            std::this_thread::yield();
+            return WaitResult::kYielded;
+        }
+        return WaitResult::kSpun;
+    }
+
+    void OnAcquired(size_t /*num_tries*/, bool /*parked*/) {
+    }
+};
+
+// Spin with a PAUSE hint for a budget, then sleep on the futex.
+// The budget follows the number of polls recent contended acquisitions needed,
+// which tracks how long the lock is held: short critical sections are waited out
+// by spinning, long ones go to sleep right away.
+class ParkWait {
 public:
-    void Lock() {
-        size_t max_num_tries = 10;
-        size_t num_tries = 0;
-        while (locked_.exchange(true, std::memory_order_acquire)) {
-            while (locked_.load(std::memory_order_relaxed)) {
-                if (++num_tries >= max_num_tries) {
-                    std::this_thread::yield();
-                    num_tries = 0;
-                }
+    static constexpr bool kParks = true;
+    static constexpr int64_t kMinSpins = 16;
+    static constexpr int64_t kMaxSpins = 4'096;
+
+    WaitResult Wait(size_t num_tries) {
+        if (static_cast<int64_t>(num_tries) < spin_budget_.load(std::memory_order_relaxed)) {
+            CpuRelax();
+            return WaitResult::kSpun;
+        }
+        return WaitResult::kPark;
+    }
+
+    // Called with the lock held, so budget updates do not race with each other
+    void OnAcquired(size_t num_tries, bool parked) {
+        auto budget = spin_budget_.load(std::memory_order_relaxed);
+        auto target = kMinSpins;
+        if (!parked) {
+            target = std::clamp(2 * static_cast<int64_t>(num_tries), kMinSpins, kMaxSpins);
+        }
+        spin_budget_.store(budget + (target - budget) / 8, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<int64_t> spin_budget_{kMaxSpins / 4};
+};
+
+// Contention counters of a BasicSpinLock, summed over all threads
+struct SpinLockStats {
+    // Bucket i counts critical sections that took [2^(i-1), 2^i) nanoseconds
+    static constexpr size_t kNumBuckets = 40;
+
+    uint64_t acquisitions = 0;
+    uint64_t contended_acquisitions = 0;
+    uint64_t spins = 0;
+    uint64_t yields = 0;
+    uint64_t parks = 0;
+    std::array<uint64_t, kNumBuckets> hold_time_ns{};
+};
+
+inline std::ostream& operator<<(std::ostream& out, const SpinLockStats& stats) {
+    out << "acquisitions " << stats.acquisitions << ", contended " << stats.contended_acquisitions
+        << ", spins " << stats.spins << ", yields " << stats.yields << ", parks " << stats.parks
+        << "\nhold time histogram (ns):";
+    for (size_t i = 0; i < SpinLockStats::kNumBuckets; ++i) {
+        if (stats.hold_time_ns[i]) {
+            out << "\n  < " << (uint64_t{1} << i) << ": " << stats.hold_time_ns[i];
+        }
+    }
+    return out;
+}
+
+namespace spinlock_detail {
+
+struct NoStats {
+    void OnAcquired(bool /*contended*/, size_t /*num_spins*/, size_t /*num_yields*/,
+                    bool /*parked*/) {
+    }
+
+    void OnRelease() {
+    }
+};
+
+// Counters live in cache-line-padded slots picked by thread,
+// so collecting them does not add contention of its own
+class StatsCollector {
+public:
+    static constexpr size_t kNumSlots = 64;
+
+    void OnAcquired(bool contended, size_t num_spins, size_t num_yields, bool parked) {
+        auto& slot = ThisThreadSlot();
+        Add(slot.acquisitions, 1);
+        if (contended) {
+            Add(slot.contended_acquisitions, 1);
+            Add(slot.spins, num_spins);
+            Add(slot.yields, num_yields);
+            Add(slot.parks, parked);
+        }
+        acquired_at_ = std::chrono::steady_clock::now();
+    }
+
+    // Called by the owner right before the lock is released
+    void OnRelease() {
+        auto hold_time = std::chrono::steady_clock::now() - acquired_at_;
+        auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(hold_time).count();
+        auto bucket = std::min<size_t>(std::bit_width(static_cast<uint64_t>(nanoseconds)),
+                                       SpinLockStats::kNumBuckets - 1);
+        Add(ThisThreadSlot().hold_time_ns[bucket], 1);
+    }
+
+    SpinLockStats Snapshot() const {
+        SpinLockStats stats;
+        for (size_t i = 0; i < kNumSlots; ++i) {
+            const auto& slot = slots_[i];
+            stats.acquisitions += slot.acquisitions.load(std::memory_order_relaxed);
+            stats.contended_acquisitions +=
+                slot.contended_acquisitions.load(std::memory_order_relaxed);
+            stats.spins += slot.spins.load(std::memory_order_relaxed);
+            stats.yields += slot.yields.load(std::memory_order_relaxed);
+            stats.parks += slot.parks.load(std::memory_order_relaxed);
+            for (size_t j = 0; j < SpinLockStats::kNumBuckets; ++j) {
+                stats.hold_time_ns[j] += slot.hold_time_ns[j].load(std::memory_order_relaxed);
             }
         }
+        return stats;
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> acquisitions{0};
+        std::atomic<uint64_t> contended_acquisitions{0};
+        std::atomic<uint64_t> spins{0};
+        std::atomic<uint64_t> yields{0};
+        std::atomic<uint64_t> parks{0};
+        std::array<std::atomic<uint64_t>, SpinLockStats::kNumBuckets> hold_time_ns{};
+    };
+
+    static void Add(std::atomic<uint64_t>& counter, uint64_t value) {
+        counter.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    Slot& ThisThreadSlot() {
+        static std::atomic<size_t> next_index{0};
+        static thread_local size_t index = next_index.fetch_add(1) % kNumSlots;
+        return slots_[index];
+    }
+
+    std::unique_ptr<Slot[]> slots_ = std::make_unique<Slot[]>(kNumSlots);
+    // Written only by the current owner
+    std::chrono::steady_clock::time_point acquired_at_;
+};
+
+}  // namespace spinlock_detail
+
+// kCollectStats turns on contention counters available through GetStats();
+// when it is off the lock has no extra state and no extra code on any path
+template <class WaitPolicy, bool kCollectStats = false>
+class BasicSpinLock {
+public:
+    void Lock() {
+        if (TryAcquire()) {
+            stats_.OnAcquired(/*contended=*/false, 0, 0, /*parked=*/false);
+        } else {
+            LockSlow();
+        }
+    }
+
+    bool TryLock() {
+        if (TryAcquire()) {
+            stats_.OnAcquired(/*contended=*/false, 0, 0, /*parked=*/false);
+            return true;
+        }
+        return false;
     }
 
     void Unlock() {
-        locked_.store(false, std::memory_order_release);
+        stats_.OnRelease();
+        auto locked_atm = std::atomic_ref<int>(locked_);
+        if constexpr (WaitPolicy::kParks) {
+            if (locked_atm.exchange(0, std::memory_order_release) == 2) {
+                FutexWake(&locked_, 1);
+            }
+        } else {
+            locked_atm.store(0, std::memory_order_release);
+        }
+    }
+
+    SpinLockStats GetStats() const
+        requires kCollectStats
+    {
+        return stats_.Snapshot();
     }
 
 private:
-    std::atomic<bool> locked_{false};
+    using Stats = std::conditional_t<kCollectStats, spinlock_detail::StatsCollector,
+                                     spinlock_detail::NoStats>;
+
+    bool TryAcquire() {
+        int zero = 0;
+        return std::atomic_ref<int>(locked_).compare_exchange_strong(
+            zero, 1, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    void LockSlow() {
+        auto locked_atm = std::atomic_ref<int>(locked_);
+        size_t num_tries = 0;
+        size_t num_yields = 0;
+        do {
+            while (locked_atm.load(std::memory_order_relaxed) != 0) {
+                auto result = wait_.Wait(num_tries++);
+                if (result == WaitResult::kPark) {
+                    Park();
+                    wait_.OnAcquired(num_tries, /*parked=*/true);
+                    stats_.OnAcquired(/*contended=*/true, num_tries, num_yields, /*parked=*/true);
+                    return;
+                }
+                num_yields += (result == WaitResult::kYielded);
+            }
+        } while (!TryAcquire());
+        wait_.OnAcquired(num_tries, /*parked=*/false);
+        stats_.OnAcquired(/*contended=*/true, num_tries, num_yields, /*parked=*/false);
+    }
+
+    // 0 - unlocked, 1 - locked, 2 - locked and somebody may sleep on the futex
+    void Park() {
+        auto locked_atm = std::atomic_ref<int>(locked_);
+        while (locked_atm.exchange(2, std::memory_order_acquire) != 0) {
+            FutexWait(&locked_, /*old=*/2);
+        }
+    }
+
+    int locked_{0};
+    [[no_unique_address]] WaitPolicy wait_;
+    [[no_unique_address]] Stats stats_;
 };
+
+using SpinLock = BasicSpinLock<YieldWait>;
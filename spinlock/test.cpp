@@ -1,7 +1,14 @@
 #include "spinlock.h"
+#include "queue_lock.h"
+#include "combining.h"
+#include "cohort_lock.h"
+#include "util.h"
 
 #include <vector>
 #include <thread>
+#include <atomic>
+#include <numeric>
+#include <stdexcept>
 
 #include <catch2/catch_test_macros.hpp>
 
@@ -43,3 +50,160 @@ TEST_CASE("Concurrency") {
     threads.clear();
     REQUIRE(counter == kThreadsCount * kNumLocks);
 }
+
+template <class Lock>
+static void TestConcurrency() {
+    static constexpr auto kThreadsCount = 16;
+    static constexpr auto kNumLocks = 1'000;
+    std::vector<std::jthread> threads;
+    auto counter = 0;
+    Lock lock;
+    for (auto i = 0u; i < kThreadsCount; ++i) {
+        threads.emplace_back([&] {
+            for (auto j = 0; j < kNumLocks; ++j) {
+                lock.Lock();
+                ++counter;
+                lock.Unlock();
+            }
+        });
+    }
+    threads.clear();
+    REQUIRE(counter == kThreadsCount * kNumLocks);
+}
+
+template <class Lock>
+static void TestFifo() {
+    static constexpr auto kThreadsCount = 5;
+    Lock lock;
+    std::vector<int> order;
+    std::vector<std::jthread> threads;
+    lock.Lock();
+    for (auto i = 0; i < kThreadsCount; ++i) {
+        threads.emplace_back([&, i] {
+            lock.Lock();
+            order.push_back(i);
+            lock.Unlock();
+        });
+        std::this_thread::sleep_for(20ms);
+    }
+    lock.Unlock();
+    threads.clear();
+    REQUIRE(order == std::vector<int>{0, 1, 2, 3, 4});
+}
+
+TEST_CASE("QueueLocks") {
+    TestConcurrency<TicketLock>();
+    TestConcurrency<MCSLock>();
+    TestConcurrency<CLHLock>();
+
+    TestFifo<TicketLock>();
+    TestFifo<MCSLock>();
+    TestFifo<CLHLock>();
+}
+
+TEST_CASE("WaitPolicies") {
+    TestConcurrency<BasicSpinLock<PauseWait>>();
+    TestConcurrency<BasicSpinLock<BackoffWait>>();
+    TestConcurrency<BasicSpinLock<YieldWait>>();
+    TestConcurrency<BasicSpinLock<ParkWait>>();
+}
+
+TEST_CASE("ParkWait") {
+    BasicSpinLock<ParkWait> spin;
+    std::atomic_flag holder_is_ready;
+    std::jthread holder{[&] {
+        spin.Lock();
+        holder_is_ready.test_and_set();
+        holder_is_ready.notify_one();
+        std::this_thread::sleep_for(1s);
+        spin.Unlock();
+    }};
+
+    holder_is_ready.wait(false);
+    std::jthread waiter{[&] {
+        CPUTimer timer{CPUTimer::THREAD};
+        spin.Lock();
+        auto cpu_time = timer.GetTimes().cpu_time;
+        INFO("waiter should go to sleep after the spin budget is exhausted");
+        CHECK(cpu_time < 50ms);
+        spin.Unlock();
+    }};
+}
+
+TEST_CASE("Stats") {
+    static constexpr auto kThreadsCount = 8;
+    static constexpr auto kNumLocks = 1'000;
+    BasicSpinLock<PauseWait, /*kCollectStats=*/true> spin;
+    std::vector<std::jthread> threads;
+    for (auto i = 0; i < kThreadsCount; ++i) {
+        threads.emplace_back([&] {
+            for (auto j = 0; j < kNumLocks; ++j) {
+                spin.Lock();
+                spin.Unlock();
+            }
+        });
+    }
+    threads.clear();
+
+    auto stats = spin.GetStats();
+    REQUIRE(stats.acquisitions == kThreadsCount * kNumLocks);
+    REQUIRE(stats.contended_acquisitions <= stats.acquisitions);
+    REQUIRE(stats.yields == 0);
+    auto num_holds = std::reduce(stats.hold_time_ns.begin(), stats.hold_time_ns.end());
+    REQUIRE(num_holds == stats.acquisitions);
+
+    static_assert(sizeof(SpinLock) == sizeof(int));
+}
+
+TEST_CASE("Combining") {
+    static constexpr auto kThreadsCount = 16;
+    static constexpr auto kNumOps = 10'000;
+    Combining<SpinLock> combining;
+    auto counter = 0;
+    std::vector<std::jthread> threads;
+    for (auto i = 0; i < kThreadsCount; ++i) {
+        threads.emplace_back([&] {
+            for (auto j = 0; j < kNumOps; ++j) {
+                combining.Execute([&] { ++counter; });
+            }
+        });
+    }
+    threads.clear();
+    REQUIRE(counter == kThreadsCount * kNumOps);
+
+    REQUIRE_THROWS_AS(combining.Execute([] { throw std::runtime_error{"op"}; }),
+                      std::runtime_error);
+    combining.Execute([&] { ++counter; });
+    REQUIRE(counter == kThreadsCount * kNumOps + 1);
+}
+
+static thread_local size_t simulated_cpu = 0;
+
+TEST_CASE("CohortLock") {
+    REQUIRE(NumaTopology::ParseCpuList("0-3,8,10-11") ==
+            std::vector<size_t>{0, 1, 2, 3, 8, 10, 11});
+    REQUIRE(NumaTopology::Detect().NumNodes() >= 1);
+
+    static constexpr auto kThreadsCount = 8;
+    static constexpr auto kNumLocks = 10'000;
+    for (auto max_local_handoffs : {1u, 64u}) {
+        auto topology = NumaTopology::Simulate(2, 4, [] { return simulated_cpu; });
+        REQUIRE(topology.NumNodes() == 2);
+        REQUIRE(topology.CpusOfNode(1) == std::vector<size_t>{2, 3});
+        CohortLock lock{topology, max_local_handoffs};
+        auto counter = 0;
+        std::vector<std::jthread> threads;
+        for (auto i = 0u; i < kThreadsCount; ++i) {
+            threads.emplace_back([&, i] {
+                simulated_cpu = i % 4;
+                for (auto j = 0; j < kNumLocks; ++j) {
+                    lock.Lock();
+                    ++counter;
+                    lock.Unlock();
+                }
+            });
+        }
+        threads.clear();
+        REQUIRE(counter == kThreadsCount * kNumLocks);
+    }
+}
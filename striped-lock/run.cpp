@@ -0,0 +1,46 @@
+#include "striped_lock.h"
+#include "runner.h"
+
+#include <string>
+#include <vector>
+#include <thread>
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+namespace {
+
+constexpr auto kNumIterations = 1'000'000;
+constexpr auto kNumCounters = 4'096;
+
+template <class Lock, size_t N>
+void RunBenchmark(const std::string& name, uint32_t num_threads) {
+    StripedLock<Lock, N> lock;
+    std::vector<int64_t> counters(kNumCounters);
+    BENCHMARK(name + "[" + std::to_string(N) + "] " + std::to_string(num_threads)) {
+        Runner runner{kNumIterations};
+        for (auto i = 0u; i < num_threads; ++i) {
+            runner.Do([&, key = i * 7919u]() mutable {
+                key = (key * 1'103'515'245u + 12'345u) % kNumCounters;
+                lock.Write(key, [&] { ++counters[key]; });
+            });
+        }
+    };
+}
+
+template <class Lock>
+void RunBenchmarks(const std::string& name, uint32_t num_threads) {
+    RunBenchmark<Lock, 1>(name, num_threads);
+    RunBenchmark<Lock, 16>(name, num_threads);
+    RunBenchmark<Lock, 256>(name, num_threads);
+}
+
+}  // namespace
+
+TEST_CASE("Benchmark") {
+    for (auto num_threads : {1u, 2u, 4u, 8u, 16u, std::thread::hardware_concurrency()}) {
+        RunBenchmarks<SpinLock>("SpinLock", num_threads);
+        RunBenchmarks<Mutex>("Mutex", num_threads);
+        RunBenchmarks<RWLock>("RWLock", num_threads);
+    }
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "../spinlock/spinlock.h"
+#include "../mutex/mutex.h"
+#include "../rw-lock/rw_lock.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <ranges>
+#include <vector>
+
+// N locks, each on its own cache line; a key is protected by stripe Hash(key) % N.
+// Lock is either BasicLockable-style (Lock()/Unlock(), e.g. SpinLock or Mutex)
+// or callback-style (Read(func)/Write(func), e.g. RWLock).
+//
+// Resize protocol for a striped hash table: keep the number of buckets a multiple
+// of N and put a key into bucket Hash(key) % num_buckets. Then every bucket is
+// covered by exactly one stripe whatever the table size, so operations on a key
+// take only its stripe, and a resize rehashes the table inside LockAll, which holds
+// every stripe.
+template <class Lock, size_t N>
+class StripedLock {
+    static_assert(N > 0);
+
+    static constexpr bool kHasCallbacks = requires(Lock& lock) {
+        lock.Read([] {});
+        lock.Write([] {});
+    };
+
+public:
+    static constexpr size_t kNumStripes = N;
+
+    // std::hash of integers is the identity, so mix the bits before taking a remainder
+    template <class Key>
+    static uint64_t Hash(const Key& key) {
+        uint64_t x = std::hash<Key>{}(key);
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+    template <class Key>
+    static size_t StripeOf(const Key& key) {
+        return Hash(key) % N;
+    }
+
+    template <class Key>
+    void Write(const Key& key, auto func) {
+        Exclusive(stripes_[StripeOf(key)].lock, func);
+    }
+
+    // Shared access when Lock supports it, exclusive otherwise
+    template <class Key>
+    void Read(const Key& key, auto func) {
+        auto& lock = stripes_[StripeOf(key)].lock;
+        if constexpr (kHasCallbacks) {
+            lock.Read([&func] { func(); });
+        } else {
+            Exclusive(lock, func);
+        }
+    }
+
+    // Exclusive access to the stripes of all keys. Stripes are taken in increasing
+    // order, so concurrent LockMany and LockAll calls cannot deadlock.
+    template <std::ranges::input_range Keys>
+    void LockMany(const Keys& keys, auto func) {
+        std::vector<size_t> indices;
+        for (const auto& key : keys) {
+            indices.push_back(StripeOf(key));
+        }
+        std::ranges::sort(indices);
+        auto last = std::ranges::unique(indices).begin();
+        indices.erase(last, indices.end());
+        LockStripes(indices, 0, func);
+    }
+
+    template <class Key>
+    void LockMany(std::initializer_list<Key> keys, auto func) {
+        LockMany<std::initializer_list<Key>>(keys, std::move(func));
+    }
+
+    // Exclusive access to the whole table, e.g. to resize it
+    void LockAll(auto func) {
+        std::vector<size_t> indices(N);
+        for (size_t i = 0; i < N; ++i) {
+            indices[i] = i;
+        }
+        LockStripes(indices, 0, func);
+    }
+
+private:
+    struct alignas(64) Stripe {
+        Lock lock;
+    };
+
+    template <class Func>
+    static void Exclusive(Lock& lock, Func& func) {
+        if constexpr (kHasCallbacks) {
+            lock.Write([&func] { func(); });
+        } else {
+            lock.Lock();
+            try {
+                func();
+            } catch (...) {
+                lock.Unlock();
+                throw;
+            }
+            lock.Unlock();
+        }
+    }
+
+    template <class Func>
+    void LockStripes(const std::vector<size_t>& indices, size_t pos, Func& func) {
+        if (pos == indices.size()) {
+            func();
+            return;
+        }
+        auto next = [&] { LockStripes(indices, pos + 1, func); };
+        Exclusive(stripes_[indices[pos]].lock, next);
+    }
+
+    std::array<Stripe, N> stripes_;
+};
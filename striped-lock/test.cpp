@@ -0,0 +1,152 @@
+#include "striped_lock.h"
+
+#include <thread>
+#include <vector>
+#include <list>
+#include <atomic>
+#include <algorithm>
+
+#include <catch2/catch_test_macros.hpp>
+
+namespace {
+
+// Hash set that follows the resize protocol described in striped_lock.h
+template <class Lock>
+class StripedHashSet {
+public:
+    static constexpr size_t kNumStripes = 16;
+
+    bool Insert(int value) {
+        bool inserted = false;
+        lock_.Write(value, [&] {
+            auto& bucket = BucketOf(value);
+            if (std::ranges::find(bucket, value) == bucket.end()) {
+                bucket.push_back(value);
+                inserted = true;
+            }
+        });
+        if (inserted && size_.fetch_add(1) + 1 > 2 * buckets_size_.load()) {
+            Resize();
+        }
+        return inserted;
+    }
+
+    bool Contains(int value) {
+        bool found = false;
+        lock_.Read(value, [&] {
+            auto& bucket = BucketOf(value);
+            found = std::ranges::find(bucket, value) != bucket.end();
+        });
+        return found;
+    }
+
+    size_t NumBuckets() const {
+        return buckets_size_.load();
+    }
+
+private:
+    std::list<int>& BucketOf(int value) {
+        return buckets_[StripedLock<Lock, kNumStripes>::Hash(value) % buckets_.size()];
+    }
+
+    void Resize() {
+        lock_.LockAll([&] {
+            if (size_.load() <= 2 * buckets_.size()) {
+                return;
+            }
+            std::vector<std::list<int>> buckets(2 * buckets_.size());
+            for (auto& bucket : buckets_) {
+                for (auto value : bucket) {
+                    auto hash = StripedLock<Lock, kNumStripes>::Hash(value);
+                    buckets[hash % buckets.size()].push_back(value);
+                }
+            }
+            buckets_.swap(buckets);
+            buckets_size_.store(buckets_.size());
+        });
+    }
+
+    StripedLock<Lock, kNumStripes> lock_;
+    std::vector<std::list<int>> buckets_ = std::vector<std::list<int>>(kNumStripes);
+    std::atomic<size_t> buckets_size_{kNumStripes};
+    std::atomic<size_t> size_{0};
+};
+
+template <class Lock>
+void TestHashSet() {
+    static constexpr auto kNumThreads = 8;
+    static constexpr auto kNumValues = 10'000;
+    StripedHashSet<Lock> set;
+    std::atomic<int> num_inserted{0};
+    std::atomic<int> num_errors{0};
+    std::vector<std::jthread> threads;
+    for (auto i = 0; i < kNumThreads; ++i) {
+        threads.emplace_back([&, i] {
+            for (auto value = 0; value < kNumValues; ++value) {
+                num_inserted += set.Insert(value);
+                num_errors += !set.Contains(value);
+                num_errors += set.Contains(kNumValues + i);
+            }
+        });
+    }
+    threads.clear();
+    REQUIRE(num_inserted == kNumValues);
+    REQUIRE(num_errors == 0);
+    REQUIRE(set.NumBuckets() > StripedHashSet<Lock>::kNumStripes);
+}
+
+// Transfers between accounts in different stripes must not deadlock
+template <class Lock>
+void TestLockMany() {
+    static constexpr auto kNumThreads = 8;
+    static constexpr auto kNumAccounts = 100;
+    static constexpr auto kNumTransfers = 10'000;
+    StripedLock<Lock, 8> lock;
+    std::vector<int64_t> accounts(kNumAccounts, 100);
+    std::vector<std::jthread> threads;
+    for (auto i = 0; i < kNumThreads; ++i) {
+        threads.emplace_back([&, i] {
+            for (auto j = 0; j < kNumTransfers; ++j) {
+                auto from = (i * 7 + j) % kNumAccounts;
+                auto to = (i * 13 + j * 3 + 1) % kNumAccounts;
+                lock.LockMany({from, to}, [&] {
+                    --accounts[from];
+                    ++accounts[to];
+                });
+            }
+        });
+    }
+    threads.clear();
+
+    int64_t total = 0;
+    lock.LockAll([&] {
+        for (auto value : accounts) {
+            total += value;
+        }
+    });
+    REQUIRE(total == 100 * kNumAccounts);
+}
+
+}  // namespace
+
+TEST_CASE("Stripes") {
+    StripedLock<SpinLock, 64> lock;
+    static_assert(sizeof(lock) == 64 * 64);
+    std::vector<size_t> hits(64);
+    for (auto key = 0; key < 64'000; ++key) {
+        ++hits[lock.StripeOf(key)];
+    }
+    REQUIRE(std::ranges::min(hits) > 500);
+}
+
+TEST_CASE("HashSet") {
+    TestHashSet<SpinLock>();
+    TestHashSet<Mutex>();
+    TestHashSet<RWLock>();
+}
+
+TEST_CASE("LockMany") {
+    TestLockMany<SpinLock>();
+    TestLockMany<Mutex>();
+    TestLockMany<RWLock>();
+}
@@ -0,0 +1,43 @@
+#include "sync.h"
+
+#include <barrier>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+// Average time between consecutive phases of a barrier shared by num_threads threads
+template <class BarrierType>
+static void RunRoundTrip(const std::string& name, int num_threads) {
+    static constexpr auto kNumPhases = 10'000;
+    BarrierType barrier{num_threads};
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::vector<std::jthread> threads;
+        for (auto i = 0; i < num_threads; ++i) {
+            threads.emplace_back([&] {
+                for (auto phase = 0; phase < kNumPhases; ++phase) {
+                    if constexpr (requires { barrier.ArriveAndWait(); }) {
+                        barrier.ArriveAndWait();
+                    } else {
+                        barrier.arrive_and_wait();
+                    }
+                }
+            });
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << name << " " << num_threads << " threads: "
+              << std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / kNumPhases
+              << "ns per round trip" << std::endl;
+}
+
+TEST_CASE("Barrier") {
+    for (auto num_threads : {2, 4, 8, 16, 32, 64}) {
+        RunRoundTrip<Barrier>("Barrier", num_threads);
+        RunRoundTrip<std::barrier<>>("std::barrier", num_threads);
+    }
+}
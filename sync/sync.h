@@ -0,0 +1,223 @@
+#pragma once
+
+#include "../mutex/mutex.h"
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+
+// Coordination primitives on a single futex word each: the fast path is one atomic
+// operation, and the futex is touched only when somebody has announced that it sleeps
+
+namespace sync_detail {
+
+// The counter lives in the low bits, kWaiters is set by threads about to sleep
+inline constexpr int kWaiters = 1 << 30;
+inline constexpr int kCountMask = kWaiters - 1;
+
+inline void WaitForZero(int& state) {
+    auto state_atm = std::atomic_ref<int>(state);
+    auto value = state_atm.load(std::memory_order::acquire);
+    while (value & kCountMask) {
+        if (!(value & kWaiters) &&
+            !state_atm.compare_exchange_weak(value, value | kWaiters, std::memory_order::acquire)) {
+            continue;
+        }
+        FutexWait(&state, value | kWaiters);
+        value = state_atm.load(std::memory_order::acquire);
+    }
+}
+
+// Adds delta to the counter, wakes everybody if it drops to zero
+inline void AddToCount(int& state, int delta) {
+    auto state_atm = std::atomic_ref<int>(state);
+    auto old = state_atm.load(std::memory_order::relaxed);
+    int count;
+    do {
+        count = (old & kCountMask) + delta;
+        if (count < 0 || count > kCountMask) {
+            throw std::logic_error{"counter out of range"};
+        }
+    } while (!state_atm.compare_exchange_weak(old, count ? (old & kWaiters) | count : 0,
+                                              std::memory_order::acq_rel,
+                                              std::memory_order::relaxed));
+    if (count == 0 && (old & kWaiters)) {
+        FutexWake(&state, -1);
+    }
+}
+
+}  // namespace sync_detail
+
+// Manual-reset event stays set until Reset(); auto-reset event lets exactly one Wait()
+// through per Set() and resets itself
+template <bool kAutoReset>
+class BasicEvent {
+public:
+    void Set() {
+        auto old = std::atomic_ref<int>(state_).exchange(kSet, std::memory_order::release);
+        if (old == kWaiting) {
+            FutexWake(&state_, kAutoReset ? 1 : -1);
+        }
+    }
+
+    void Reset() {
+        auto expected = kSet;
+        std::atomic_ref<int>(state_).compare_exchange_strong(expected, kUnset,
+                                                             std::memory_order::relaxed);
+    }
+
+    bool TryWait() {
+        auto state_atm = std::atomic_ref<int>(state_);
+        if constexpr (kAutoReset) {
+            auto expected = kSet;
+            return state_atm.compare_exchange_strong(expected, kUnset, std::memory_order::acquire);
+        } else {
+            return state_atm.load(std::memory_order::acquire) == kSet;
+        }
+    }
+
+    void Wait() {
+        auto state_atm = std::atomic_ref<int>(state_);
+        auto value = state_atm.load(std::memory_order::acquire);
+        auto slept = false;
+        while (true) {
+            if (value == kSet) {
+                if constexpr (!kAutoReset) {
+                    return;
+                }
+                // After sleeping assume there are other sleepers, so the next Set wakes one
+                if (state_atm.compare_exchange_weak(value, slept ? kWaiting : kUnset,
+                                                    std::memory_order::acquire)) {
+                    return;
+                }
+                continue;
+            }
+            if (value == kUnset &&
+                !state_atm.compare_exchange_weak(value, kWaiting, std::memory_order::relaxed)) {
+                continue;
+            }
+            FutexWait(&state_, kWaiting);
+            slept = true;
+            value = state_atm.load(std::memory_order::acquire);
+        }
+    }
+
+private:
+    static constexpr int kUnset = 0;
+    static constexpr int kSet = 1;
+    // Unset and somebody may sleep on the futex
+    static constexpr int kWaiting = 2;
+
+    int state_{kUnset};
+};
+
+using Event = BasicEvent<false>;
+using AutoResetEvent = BasicEvent<true>;
+
+// Single-use countdown, like std::latch
+class Latch {
+public:
+    explicit Latch(int count) : state_{count} {
+        if (count < 0 || count > sync_detail::kCountMask) {
+            throw std::invalid_argument{"invalid Latch count"};
+        }
+    }
+
+    void CountDown(int n = 1) {
+        sync_detail::AddToCount(state_, -n);
+    }
+
+    bool TryWait() {
+        return !(std::atomic_ref<int>(state_).load(std::memory_order::acquire) &
+                 sync_detail::kCountMask);
+    }
+
+    void Wait() {
+        sync_detail::WaitForZero(state_);
+    }
+
+    void ArriveAndWait(int n = 1) {
+        CountDown(n);
+        Wait();
+    }
+
+private:
+    int state_;
+};
+
+// Reusable sense-reversing barrier: the last thread to arrive resets the counter and
+// flips the sense bit in the same store, which releases the waiters of this phase
+class Barrier {
+public:
+    static constexpr size_t kMaxSpins = 128;
+    static constexpr size_t kMaxYields = 16;
+
+    explicit Barrier(int num_threads) : num_threads_{num_threads} {
+        if (num_threads <= 0 || num_threads > kCountMask) {
+            throw std::invalid_argument{"invalid Barrier size"};
+        }
+    }
+
+    void ArriveAndWait() {
+        auto state_atm = std::atomic_ref<int>(state_);
+        auto old = state_atm.fetch_add(1, std::memory_order::acq_rel);
+        auto sense = old & kSense;
+        if ((old & kCountMask) + 1 == num_threads_) {
+            old = state_atm.exchange(sense ^ kSense, std::memory_order::acq_rel);
+            if (old & kWaiters) {
+                FutexWake(&state_, -1);
+            }
+            return;
+        }
+
+        size_t num_spins = 0;
+        auto value = state_atm.load(std::memory_order::acquire);
+        while ((value & kSense) == sense) {
+            if (num_spins < kMaxSpins + kMaxYields) {
+                // The threads still to arrive may need this CPU
+                if (num_spins++ < kMaxSpins) {
+                    CpuRelax();
+                } else {
+                    std::this_thread::yield();
+                }
+            } else if ((value & kWaiters) ||
+                       state_atm.compare_exchange_weak(value, value | kWaiters,
+                                                       std::memory_order::acquire)) {
+                // Late arrivals change the word, then the futex returns right away and we retry
+                FutexWait(&state_, value | kWaiters);
+            } else {
+                continue;
+            }
+            value = state_atm.load(std::memory_order::acquire);
+        }
+    }
+
+private:
+    static constexpr int kSense = 1 << 30;
+    static constexpr int kWaiters = 1 << 29;
+    static constexpr int kCountMask = kWaiters - 1;
+
+    int state_{0};
+    const int num_threads_;
+};
+
+// Go-style sync.WaitGroup: Add before starting the work, Done when it finishes,
+// Wait until the counter drops to zero
+class WaitGroup {
+public:
+    void Add(int delta = 1) {
+        sync_detail::AddToCount(state_, delta);
+    }
+
+    void Done() {
+        Add(-1);
+    }
+
+    void Wait() {
+        sync_detail::WaitForZero(state_);
+    }
+
+private:
+    int state_{0};
+};
@@ -0,0 +1,126 @@
+#include "sync.h"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Event") {
+    static constexpr auto kNumWaiters = 8;
+    Event event;
+    CHECK_FALSE(event.TryWait());
+    std::atomic<int> num_woken = 0;
+    {
+        std::vector<std::jthread> threads;
+        for (auto i = 0; i < kNumWaiters; ++i) {
+            threads.emplace_back([&] {
+                event.Wait();
+                ++num_woken;
+            });
+        }
+        std::this_thread::sleep_for(50ms);
+        CHECK(num_woken == 0);
+        event.Set();
+    }
+    CHECK(num_woken == kNumWaiters);
+    CHECK(event.TryWait());
+    event.Wait();
+    event.Reset();
+    CHECK_FALSE(event.TryWait());
+}
+
+TEST_CASE("AutoResetEvent") {
+    static constexpr auto kNumWaiters = 8;
+    AutoResetEvent event;
+    std::atomic<int> num_woken = 0;
+    std::vector<std::jthread> threads;
+    for (auto i = 0; i < kNumWaiters; ++i) {
+        threads.emplace_back([&] {
+            event.Wait();
+            ++num_woken;
+        });
+    }
+    for (auto i = 1; i <= kNumWaiters; ++i) {
+        std::this_thread::sleep_for(20ms);
+        event.Set();
+        while (num_woken < i) {
+            std::this_thread::yield();
+        }
+        std::this_thread::sleep_for(20ms);
+        CHECK(num_woken == i);
+    }
+    threads.clear();
+
+    event.Set();
+    CHECK(event.TryWait());
+    CHECK_FALSE(event.TryWait());
+}
+
+TEST_CASE("Latch") {
+    static constexpr auto kNumThreads = 8;
+    Latch latch{kNumThreads};
+    std::atomic<int> num_arrived = 0;
+    std::vector<std::jthread> threads;
+    for (auto i = 0; i < kNumThreads; ++i) {
+        threads.emplace_back([&] {
+            ++num_arrived;
+            latch.ArriveAndWait();
+            CHECK(num_arrived == kNumThreads);
+        });
+    }
+    latch.Wait();
+    CHECK(latch.TryWait());
+    CHECK_THROWS_AS(latch.CountDown(), std::logic_error);
+    CHECK_THROWS_AS(Latch{-1}, std::invalid_argument);
+}
+
+TEST_CASE("Barrier") {
+    static constexpr auto kNumThreads = 8;
+    static constexpr auto kNumPhases = 1'000;
+    Barrier barrier{kNumThreads};
+    std::vector<std::atomic<int>> arrived(kNumPhases);
+    std::atomic<int> num_errors = 0;
+    std::vector<std::jthread> threads;
+    for (auto i = 0; i < kNumThreads; ++i) {
+        threads.emplace_back([&] {
+            for (auto phase = 0; phase < kNumPhases; ++phase) {
+                ++arrived[phase];
+                barrier.ArriveAndWait();
+                if (arrived[phase] != kNumThreads) {
+                    ++num_errors;
+                }
+            }
+        });
+    }
+    threads.clear();
+    CHECK(num_errors == 0);
+}
+
+TEST_CASE("WaitGroup") {
+    static constexpr auto kNumTasks = 16;
+    WaitGroup group;
+    group.Wait();
+    std::atomic<int> num_done = 0;
+    std::vector<std::jthread> threads;
+    for (auto i = 0; i < kNumTasks; ++i) {
+        group.Add();
+        threads.emplace_back([&] {
+            std::this_thread::sleep_for(10ms);
+            ++num_done;
+            group.Done();
+        });
+    }
+    group.Wait();
+    CHECK(num_done == kNumTasks);
+    CHECK_THROWS_AS(group.Done(), std::logic_error);
+
+    group.Add(2);
+    group.Done();
+    group.Done();
+    group.Wait();
+}
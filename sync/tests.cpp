@@ -0,0 +1,15 @@
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+
+TEST(Units, Units) {
+    EXPECT_EQ(1, 1);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}